@@ -0,0 +1,169 @@
+#ifndef AIG_H
+#define AIG_H
+
+#include "tseitin.hpp"
+
+// And-inverter graph. Node 0 is constant false; every other node is an input
+// or a two-input AND. Edges are literals 2 * node + complemented, and AND
+// nodes are structurally hashed on creation, so equal sub-circuits of
+// different formulas map to the same node.
+using AigLit = uint32_t;
+
+struct Aig {
+    static constexpr AigLit False = 0, True = 1;
+    static constexpr uint32_t InputMark = UINT32_MAX;
+
+    struct Node { AigLit left, right; };
+
+    std::vector<Node> nodes = {{InputMark, InputMark}};
+    std::vector<Var> input_var = {0};
+    std::unordered_map<Var, uint32_t> inputs;
+    std::unordered_map<uint64_t, uint32_t> strash;
+
+    static uint32_t node(AigLit l) { return l >> 1; }
+    static bool complemented(AigLit l) { return l & 1; }
+    static AigLit lit(uint32_t n, bool c = false) { return 2 * n + (c ? 1 : 0); }
+
+    bool is_input(uint32_t n) const { return n != 0 && nodes[n].left == InputMark; }
+    bool is_and(uint32_t n) const { return nodes[n].left != InputMark; }
+    size_t size() const { return nodes.size(); }
+
+    AigLit input(Var v) {
+        auto [it, inserted] = inputs.try_emplace(v, uint32_t(nodes.size()));
+        if(inserted) {
+            nodes.push_back({InputMark, InputMark});
+            input_var.push_back(v);
+        }
+        return lit(it->second);
+    }
+
+    AigLit make_and(AigLit a, AigLit b) {
+        if(a > b)
+            std::swap(a, b);
+        if(a == False || a == (b ^ 1))
+            return False;
+        if(a == True || a == b)
+            return b;
+        uint64_t key = uint64_t(a) << 32 | b;
+        auto [it, inserted] = strash.try_emplace(key, uint32_t(nodes.size()));
+        if(inserted) {
+            nodes.push_back({a, b});
+            input_var.push_back(0);
+        }
+        return lit(it->second);
+    }
+
+    AigLit make_or(AigLit a, AigLit b) { return make_and(a ^ 1, b ^ 1) ^ 1; }
+    AigLit make_xor(AigLit a, AigLit b) { return make_or(make_and(a, b ^ 1), make_and(a ^ 1, b)); }
+
+    // Converts a formula bottom-up over its cone; shared subformulas and
+    // structurally equal gates are built once.
+    AigLit from_formula(const FormulaPtr& f) {
+        std::vector<AigLit> lits(store().nodes.size(), False);
+        for(uint32_t id : ::cone({f})) {
+            const Formula& n = *FormulaPtr{id};
+            if(std::holds_alternative<::True>(n))
+                lits[id] = True;
+            else if(std::holds_alternative<Atom>(n))
+                lits[id] = input(std::get<Atom>(n).var);
+            else if(std::holds_alternative<Not>(n))
+                lits[id] = lits[std::get<Not>(n).subformula.id] ^ 1;
+            else if(std::holds_alternative<Binary>(n)) {
+                const Binary& b = std::get<Binary>(n);
+                AigLit l = lits[b.left.id], r = lits[b.right.id];
+                switch(b.type) {
+                    case Binary::And:  lits[id] = make_and(l, r); break;
+                    case Binary::Or:   lits[id] = make_or(l, r); break;
+                    case Binary::Impl: lits[id] = make_or(l ^ 1, r); break;
+                    case Binary::Eq:   lits[id] = make_xor(l, r) ^ 1; break;
+                    case Binary::Xor:  lits[id] = make_xor(l, r); break;
+                    case Binary::Nand: lits[id] = make_and(l, r) ^ 1; break;
+                    case Binary::Nor:  lits[id] = make_or(l, r) ^ 1; break;
+                }
+            }
+        }
+        return lits[f.id];
+    }
+
+    // Nodes in the cone of the roots, in ascending (topological) order.
+    std::vector<uint32_t> cone(const std::vector<AigLit>& roots) const {
+        std::vector<bool> seen(nodes.size(), false);
+        std::vector<uint32_t> stack, order;
+        for(AigLit r : roots)
+            if(!seen[node(r)]) {
+                seen[node(r)] = true;
+                stack.push_back(node(r));
+            }
+        while(!stack.empty()) {
+            uint32_t n = stack.back();
+            stack.pop_back();
+            order.push_back(n);
+            if(n == 0 || !is_and(n))
+                continue;
+            for(AigLit c : {nodes[n].left, nodes[n].right})
+                if(!seen[node(c)]) {
+                    seen[node(c)] = true;
+                    stack.push_back(node(c));
+                }
+        }
+        std::sort(order.begin(), order.end());
+        return order;
+    }
+
+    // Clauses defining every AND node in the cone of the roots, using node n
+    // as solver variable n; an AigLit is then also the matching solver Lit.
+    void define_cone(const std::vector<AigLit>& roots, NormalForm& cnf) const {
+        TRACE_SCOPE("aig_cnf");
+        for(uint32_t n : cone(roots)) {
+            if(n == 0)
+                cnf.push_back({lit(0, true)});
+            else if(is_and(n)) {
+                Lit x = lit(n), a = nodes[n].left, b = nodes[n].right;
+                cnf.push_back({lit_not(x), a});
+                cnf.push_back({lit_not(x), b});
+                cnf.push_back({x, lit_not(a), lit_not(b)});
+                TRACE_COUNT(ClausesProduced, 3);
+            }
+        }
+    }
+
+    // Tseitin CNF asserting `root`: inputs keep their VarTable variables,
+    // every AND node in the cone gets an auxiliary variable.
+    EncodedCnf to_cnf(AigLit root) {
+        TRACE_SCOPE("aig_cnf");
+        EncodedCnf out;
+        if(root == True)
+            return out;
+        if(root == False) {
+            out.cnf.push_back({});
+            return out;
+        }
+        std::vector<Lit> var_lit(nodes.size(), NoLit);
+        auto cnf_lit = [&](AigLit a) { return var_lit[node(a)] ^ (a & 1); };
+        for(uint32_t n : cone({root})) {
+            if(n == 0) {
+                Var v = vars().fresh();
+                out.aux.push_back(v);
+                var_lit[0] = make_lit(v, false);
+                out.cnf.push_back({make_lit(v, true)});
+            }
+            else if(is_input(n))
+                var_lit[n] = make_lit(input_var[n], false);
+            else {
+                Var v = vars().fresh();
+                out.aux.push_back(v);
+                Lit x = make_lit(v, false);
+                var_lit[n] = x;
+                Lit a = cnf_lit(nodes[n].left), b = cnf_lit(nodes[n].right);
+                out.cnf.push_back({lit_not(x), a});
+                out.cnf.push_back({lit_not(x), b});
+                out.cnf.push_back({x, lit_not(a), lit_not(b)});
+            }
+        }
+        out.cnf.push_back({cnf_lit(root)});
+        TRACE_COUNT(ClausesProduced, out.cnf.size());
+        return out;
+    }
+};
+
+#endif
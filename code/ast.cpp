@@ -1,12 +1,159 @@
 #include "jsonGraph.hpp"
-#include "dimacs.hpp"
-#include "parsing.hpp"
+#include "dimacsReader.hpp"
+#include "pipeline.hpp"
 
 #include <bits/stdc++.h>
 #include <algorithm>
-#include <cstdlib>
 
-int main() {
+int main(int argc, char** argv) {
+    //Options
+    CnfEncoding encoding = CnfEncoding::PlaistedGreenbaum;
+    Engine engine = Engine::Aig;
+    size_t first_row = 0, max_rows = SIZE_MAX;
+    bool gray_rows = false;
+    std::string batch_file, out_file = "results.jsonl", dimacs_in, trace_file;
+    size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+    size_t portfolio = 1;
+    Compression compression = Compression::None;
+    bool share = false;
+    bool fraig = true;
+    bool preprocess = true;
+    size_t dist_budget = DistributeBudget;
+    size_t bdd_nodes = CheckOptions().bdd_node_limit;
+    size_t bdd_work = CheckOptions().bdd_work_limit;
+    size_t sim_patterns = CheckOptions().sim_patterns;
+    size_t exhaustive_inputs = CheckOptions().exhaustive_inputs;
+    for(int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if(arg == "--encoding" && a + 1 < argc) {
+            std::string e = argv[++a];
+            if(e == "dist")
+                encoding = CnfEncoding::Distribute;
+            else if(e == "tseitin")
+                encoding = CnfEncoding::Tseitin;
+            else if(e == "pg")
+                encoding = CnfEncoding::PlaistedGreenbaum;
+            else {
+                std::cout << "Unknown encoding " << e << " (dist, tseitin, pg)" << std::endl;
+                return 1;
+            }
+        }
+        else if(arg == "--engine" && a + 1 < argc) {
+            std::string e = argv[++a];
+            if(e == "cnf")
+                engine = Engine::Cnf;
+            else if(e == "aig")
+                engine = Engine::Aig;
+            else if(e == "bdd")
+                engine = Engine::Bdd;
+            else {
+                std::cout << "Unknown engine " << e << " (cnf, aig, bdd)" << std::endl;
+                return 1;
+            }
+        }
+        else if(arg == "--rows" && a + 2 < argc) {
+            first_row = std::stoull(argv[++a]);
+            max_rows = std::stoull(argv[++a]);
+        }
+        else if(arg == "--gray")
+            gray_rows = true;
+        else if(arg == "--batch" && a + 1 < argc)
+            batch_file = argv[++a];
+        else if(arg == "--out" && a + 1 < argc)
+            out_file = argv[++a];
+        else if(arg == "--dimacs" && a + 1 < argc)
+            dimacs_in = argv[++a];
+        else if(arg == "--jobs" && a + 1 < argc)
+            jobs = std::stoul(argv[++a]);
+        else if(arg == "--portfolio" && a + 1 < argc)
+            portfolio = std::stoul(argv[++a]);
+        else if(arg == "--share")
+            share = true;
+        else if(arg == "--no-fraig")
+            fraig = false;
+        else if(arg == "--no-preprocess")
+            preprocess = false;
+        else if(arg == "--trace" && a + 1 < argc)
+            trace_file = argv[++a];
+        else if(arg == "--exhaustive" && a + 1 < argc)
+            exhaustive_inputs = std::stoull(argv[++a]);
+        else if(arg == "--sim-patterns" && a + 1 < argc)
+            sim_patterns = std::stoull(argv[++a]);
+        else if(arg == "--bdd-nodes" && a + 1 < argc)
+            bdd_nodes = std::stoull(argv[++a]);
+        else if(arg == "--bdd-work" && a + 1 < argc)
+            bdd_work = std::stoull(argv[++a]);
+        else if(arg == "--dist-budget" && a + 1 < argc)
+            dist_budget = std::stoull(argv[++a]);
+        else if(arg == "--compress" && a + 1 < argc) {
+            std::string c = argv[++a];
+            compression = c == "gz" ? Compression::Gzip : c == "zst" ? Compression::Zstd : Compression::None;
+        }
+    }
+
+    CheckOptions options;
+    options.engine = engine;
+    options.encoding = encoding;
+    options.jobs = jobs;
+    options.portfolio = portfolio;
+    options.share = share;
+    options.fraig = fraig;
+    options.preprocess = preprocess;
+    options.distribute_budget = dist_budget;
+    options.bdd_node_limit = bdd_nodes;
+    options.bdd_work_limit = bdd_work;
+    options.sim_patterns = sim_patterns;
+    options.exhaustive_inputs = exhaustive_inputs;
+
+    //Tracing: Chrome trace file plus a summary table at exit
+    if(!trace_file.empty())
+        trace().start();
+    auto finish = [&](int code) {
+        if(!trace_file.empty())
+            write_trace(trace_file, std::cout);
+        return code;
+    };
+
+    //Solve an existing DIMACS benchmark
+    if(!dimacs_in.empty()) {
+        DimacsFile file = read_dimacs(dimacs_in);
+        if(!file.ok()) {
+            std::cout << "Cannot read " << dimacs_in << ": " << file.error << std::endl;
+            return finish(1);
+        }
+        std::cout << "c parsed " << file.bytes << " bytes in " << file.seconds << " s ("
+                  << file.mb_per_s() << " MB/s), " << file.max_var << " vars, "
+                  << file.cnf.size() << " clauses" << std::endl;
+        if(preprocess) {
+            Preprocessor pre(options.preprocessing);
+            file.cnf = pre.run(file.cnf);
+            std::cout << "c preprocessed to " << file.cnf.size() << " clauses (" << pre.subsumed << " subsumed, "
+                      << pre.strengthened << " strengthened, " << pre.eliminated_vars << " vars eliminated, "
+                      << pre.fixed << " fixed)" << std::endl;
+        }
+        SatAnswer answer = solve_portfolio(file.cnf, portfolio, share);
+        if(answer.result == SatResult::Sat)
+            std::cout << "s SATISFIABLE" << std::endl;
+        else if(answer.result == SatResult::Unsat)
+            std::cout << "s UNSATISFIABLE" << std::endl;
+        else
+            std::cout << "s UNKNOWN" << std::endl;
+        return finish(answer.result == SatResult::Sat ? 10 : answer.result == SatResult::Unsat ? 20 : 0);
+    }
+
+    //Batch mode: one "f ; g" pair per line, one JSON result per line
+    if(!batch_file.empty()) {
+        std::ifstream in(batch_file);
+        std::ofstream out(out_file);
+        if(!in || !out) {
+            std::cout << "Cannot open " << (!in ? batch_file : out_file) << std::endl;
+            return finish(1);
+        }
+        size_t n = run_batch(in, out, options);
+        std::cout << "Checked " << n << " pairs, results in " << out_file << std::endl;
+        return finish(0);
+    }
+
     //Input
     std::string s;
     std::cout << "How many outs:" << std::endl;
@@ -15,15 +162,20 @@ int main() {
 
     if(n_outs <= 0) {
         std::cout << "Nothing to solve!" << std::endl;
-        return 0;
+        return finish(0);
     }
 
-    std::cout << "Rules:\n() allowed\nletters for Atoms\n~ = NOT\n& = AND\n| = OR\n" << std::endl;
+    std::cout << "Rules:\n() allowed\nletters, digits and _ for Atoms (not starting with a digit)\nT = TRUE, F = FALSE\n"
+                 "~ = NOT\n& = AND\n~& = NAND\n^ = XOR\n| = OR\n~| = NOR\n-> = IMPLIES (groups to the right)\n<-> = EQUIVALENT\n"
+                 "listed from tightest to loosest binding" << std::endl;
 
     std::string f_string;
     std::string g_string;
     std::string file_name = "answer";
-    std::string dimacs_file_name;
+    std::vector<std::string> verdicts(n_outs);
+    std::vector<std::pair<FormulaPtr, FormulaPtr>> outputs;
+    std::vector<int> output_index;
+    store().clear();
     for(int i = 0; i < n_outs; i++) {
         std::cout << "Input 2 formulas you want to check:" << std::endl;
         std::getline(std::cin, f_string);
@@ -37,47 +189,77 @@ int main() {
         Parser p_g(g_string);
         FormulaPtr g = p_g.parse_string_into_formula();
 
+        if(!f || !g) {
+            std::cout << "Invalid formula!" << std::endl;
+            verdicts[i] = "Formulas f" + std::to_string(i) + " and g" + std::to_string(i) + " could not be parsed!";
+            continue;
+        }
+
         //(a | b) & c
         //(a | c) & (b | c)
         std::cout << print(f) << std::endl;
         std::cout << print(g) << std::endl;
-        print(cnf(f));
-        print(cnf(g));
+        print(cnf(f, dist_budget));
+        print(cnf(g, dist_budget));
 
         //Graph showcase
         JsonGraph f_graph;
-        auto f_data = f_graph.to_json(f);
+        auto f_data = f_graph.to_json(f, first_row, max_rows, gray_rows);
         std::string f_file_name = "f_graph_" + std::to_string(i) + ".json";
         std::ofstream(f_file_name) << f_data.dump(4);
 
         JsonGraph g_graph;
-        auto g_data = g_graph.to_json(g);
+        auto g_data = g_graph.to_json(g, first_row, max_rows, gray_rows);
         std::string g_file_name = "g_graph_" + std::to_string(i) + ".json";
         std::ofstream(g_file_name) << g_data.dump(4);
 
+        outputs.push_back({f, g});
+        output_index.push_back(i);
+
+        //Random simulation settles most non-equivalent pairs without a miter CNF
+        Valuation cex;
+        if(sim_patterns && find_difference(f, g, sim_patterns, cex)) {
+            std::cout << "Random simulation tells f" << i << " and g" << i << " apart, no miter DIMACS written" << std::endl;
+            continue;
+        }
+
         //P miter Q
         FormulaPtr miter = make_miter(f, g);
-        NormalForm miter_cnf = cnf(miter);
+        DistributeReport report;
+        EncodedCnf miter_cnf = encode(miter, encoding, dist_budget, &report);
+        if(report.encoded) {
+            std::cout << "Distribution: " << report.expanded << " subtrees expanded, "
+                      << report.encoded << " encoded with auxiliary variables:" << std::endl;
+            for(const auto& subtree : report.encoded_subtrees) {
+                std::string text = print(subtree);
+                std::cout << "  " << (text.size() > 80 ? text.substr(0, 77) + "..." : text) << std::endl;
+            }
+        }
         std::string dimacs_file_name = file_name + std::to_string(i);
-        make_dimacs(dimacs_file_name, miter_cnf);
+        if(preprocess)
+            miter_cnf.cnf = Preprocessor(options.preprocessing).run(miter_cnf.cnf);
+        if(!make_dimacs(dimacs_file_name, miter_cnf.cnf, compression))
+            std::cout << "Could not write the DIMACS file " << dimacs_file_name << std::endl;
     }
 
-    //Pipe to minisat
-    for(int j = 0; j < n_outs; j++) {
-        std::string num = std::to_string(j);
-        dimacs_file_name = file_name + num + ".cnf";
-        std::string command = "minisat " + dimacs_file_name;
-        int result = system(command.c_str());
-
-        std::string custom_msg = "";
-        switch(result/256) {
-            case 0: custom_msg = "Undefined!"; break;
-            case 10: custom_msg = "Formulas f" + num + " and g" + num + " are NOT equivalent!"; break;
-            case 20: custom_msg = "Formulas f" + num + " and g" + num + " are equivalent!"; break;
+    //Solve all miters, sharing one incremental solver between the outputs
+    std::vector<PairResult> results = check_outputs(outputs, options);
+    for(size_t k = 0; k < results.size(); k++) {
+        const PairResult& result = results[k];
+        std::string num = std::to_string(output_index[k]);
+        std::string custom_msg = "Undefined!";
+        if(result.verdict == "equivalent")
+            custom_msg = "Formulas f" + num + " and g" + num + " are equivalent!";
+        else if(result.verdict == "not_equivalent") {
+            custom_msg = "Formulas f" + num + " and g" + num + " are NOT equivalent!\nCounterexample:";
+            for(const auto& [name, value] : result.counterexample)
+                custom_msg += " " + name + "=" + (value ? "1" : "0");
         }
+        verdicts[output_index[k]] = custom_msg;
+    }
 
+    for(const auto& custom_msg : verdicts)
         std::cout << custom_msg << std::endl << std::endl;
-    }
 
-    return 0;
+    return finish(0);
 }
\ No newline at end of file
@@ -0,0 +1,348 @@
+#ifndef BDD_H
+#define BDD_H
+
+#include "formula.hpp"
+
+// Reduced ordered BDDs with complement edges. An edge is 2 * node +
+// complemented; node 0 is the constant true, so edge 0 is True and edge 1 is
+// False. High edges are never complemented, which makes every function a
+// unique edge: two formulas are equivalent iff their edges are equal.
+using BddEdge = uint32_t;
+
+struct Bdd {
+    static constexpr BddEdge True = 0, False = 1;
+    static constexpr uint32_t Terminal = UINT32_MAX, FreeMark = UINT32_MAX - 1;
+
+    struct Node { uint32_t var; BddEdge low, high; };
+    enum Op : uint32_t { NoOp, And, Xor };
+    struct CacheEntry { uint32_t op; BddEdge a, b, result; };
+
+    std::vector<Node> nodes = {{Terminal, True, True}};
+    // Parents plus external references. Nodes at 0 are dead until collected.
+    std::vector<uint32_t> refs = {1};
+    std::vector<uint32_t> free_nodes;
+    std::vector<std::unordered_map<uint64_t, uint32_t>> unique;
+    std::vector<uint32_t> level, var_at;
+    std::vector<Var> input_var;
+    std::unordered_map<Var, uint32_t> inputs;
+    std::vector<CacheEntry> cache = std::vector<CacheEntry>(size_t(1) << 16);
+
+    size_t node_limit = size_t(1) << 20;
+    // Apply steps plus nodes moved by level swaps; past work_limit `overflow`
+    // is set as well.
+    size_t work = 0, work_limit = SIZE_MAX;
+    size_t gc_threshold = size_t(1) << 14, reorder_threshold = size_t(1) << 15;
+    bool reorder = true;
+    // Sifting limits as in CUDD: the sift_max_vars largest variables are
+    // sifted per pass, each with at most sift_max_swaps swaps, and there is
+    // no reordering at all past reorder_max_vars variables.
+    size_t sift_max_vars = 1000, sift_max_swaps = 2000, reorder_max_vars = 5000;
+    // Set when an operation would exceed node_limit or work_limit; results
+    // are then void.
+    bool overflow = false;
+    size_t collections = 0, reorderings = 0;
+
+    static uint32_t node(BddEdge e) { return e >> 1; }
+    static uint64_t key(BddEdge low, BddEdge high) { return uint64_t(low) << 32 | high; }
+
+    size_t live() const { return nodes.size() - free_nodes.size(); }
+    uint32_t var_of(BddEdge e) const { return nodes[node(e)].var; }
+    uint32_t level_of(BddEdge e) const { return node(e) == 0 ? Terminal : level[var_of(e)]; }
+
+    void protect(BddEdge e) { refs[node(e)]++; }
+    void release(BddEdge e) { refs[node(e)]--; }
+
+    // Cofactor of e for var = value, where var is at or above e's level.
+    BddEdge cofactor(BddEdge e, uint32_t var, bool value) const {
+        if(node(e) == 0 || var_of(e) != var)
+            return e;
+        return (value ? nodes[node(e)].high : nodes[node(e)].low) ^ (e & 1);
+    }
+
+    BddEdge find_or_add(uint32_t var, BddEdge low, BddEdge high) {
+        if(low == high)
+            return low;
+        if(high & 1)
+            return find_or_add(var, low ^ 1, high ^ 1) ^ 1;
+        auto [it, inserted] = unique[var].try_emplace(key(low, high), 0);
+        if(inserted) {
+            uint32_t n;
+            if(free_nodes.empty()) {
+                n = uint32_t(nodes.size());
+                nodes.push_back({var, low, high});
+                refs.push_back(0);
+            }
+            else {
+                n = free_nodes.back();
+                free_nodes.pop_back();
+                nodes[n] = {var, low, high};
+            }
+            refs[node(low)]++;
+            refs[node(high)]++;
+            it->second = n;
+        }
+        return 2 * it->second;
+    }
+
+    // Counts n units of work; false once the budget is spent.
+    bool spend(size_t n) {
+        work += n;
+        if(work > work_limit)
+            overflow = true;
+        return !overflow;
+    }
+
+    BddEdge make(uint32_t var, BddEdge low, BddEdge high) {
+        if(live() >= node_limit)
+            overflow = true;
+        if(overflow)
+            return False;
+        return find_or_add(var, low, high);
+    }
+
+    // BDD variable for a VarTable variable, added below all others.
+    BddEdge input(Var v) {
+        auto [it, inserted] = inputs.try_emplace(v, uint32_t(input_var.size()));
+        if(inserted) {
+            input_var.push_back(v);
+            level.push_back(uint32_t(var_at.size()));
+            var_at.push_back(it->second);
+            unique.emplace_back();
+        }
+        return make(it->second, False, True);
+    }
+
+    CacheEntry& lookup(uint32_t op, BddEdge a, BddEdge b) {
+        uint64_t h = (uint64_t(a) * 0x9E3779B97F4A7C15ull) ^ (uint64_t(b) * 0xC2B2AE3D27D4EB4Full) ^ op;
+        return cache[(h ^ (h >> 29)) & (cache.size() - 1)];
+    }
+
+    BddEdge apply_and(BddEdge a, BddEdge b) {
+        if(a == False || b == False || a == (b ^ 1) || overflow)
+            return False;
+        if(a == True || a == b)
+            return b;
+        if(b == True)
+            return a;
+        if(a > b)
+            std::swap(a, b);
+        CacheEntry& entry = lookup(And, a, b);
+        if(entry.op == And && entry.a == a && entry.b == b)
+            return entry.result;
+        if(!spend(1))
+            return False;
+        uint32_t var = var_at[std::min(level_of(a), level_of(b))];
+        BddEdge low = apply_and(cofactor(a, var, false), cofactor(b, var, false));
+        BddEdge high = apply_and(cofactor(a, var, true), cofactor(b, var, true));
+        BddEdge r = make(var, low, high);
+        entry = {And, a, b, r};
+        return r;
+    }
+
+    BddEdge apply_xor(BddEdge a, BddEdge b) {
+        BddEdge flip = (a & 1) ^ (b & 1);
+        a &= ~1u;
+        b &= ~1u;
+        if(overflow)
+            return False;
+        if(a == b)
+            return False ^ flip;
+        if(a == True)
+            return b ^ 1 ^ flip;
+        if(b == True)
+            return a ^ 1 ^ flip;
+        if(a > b)
+            std::swap(a, b);
+        CacheEntry& entry = lookup(Xor, a, b);
+        if(entry.op == Xor && entry.a == a && entry.b == b)
+            return entry.result ^ flip;
+        if(!spend(1))
+            return False;
+        uint32_t var = var_at[std::min(level_of(a), level_of(b))];
+        BddEdge low = apply_xor(cofactor(a, var, false), cofactor(b, var, false));
+        BddEdge high = apply_xor(cofactor(a, var, true), cofactor(b, var, true));
+        BddEdge r = make(var, low, high);
+        entry = {Xor, a, b, r};
+        return r ^ flip;
+    }
+
+    BddEdge apply_or(BddEdge a, BddEdge b) { return apply_and(a ^ 1, b ^ 1) ^ 1; }
+
+    // Frees dead node n and every descendant that dies with it.
+    void free_node(uint32_t n) {
+        std::vector<uint32_t> stack = {n};
+        while(!stack.empty()) {
+            uint32_t m = stack.back();
+            stack.pop_back();
+            Node& d = nodes[m];
+            unique[d.var].erase(key(d.low, d.high));
+            for(BddEdge c : {d.low, d.high})
+                if(node(c) != 0 && --refs[node(c)] == 0)
+                    stack.push_back(node(c));
+            d.var = FreeMark;
+            free_nodes.push_back(m);
+        }
+    }
+
+    // Frees all dead nodes. The computed cache may name them, so it is
+    // cleared and resized along with the table.
+    void collect() {
+        for(uint32_t n = 1; n < nodes.size(); n++)
+            if(nodes[n].var != FreeMark && refs[n] == 0)
+                free_node(n);
+        size_t size = cache.size();
+        while(size < live() && size < (size_t(1) << 22))
+            size *= 2;
+        cache.assign(size, CacheEntry{NoOp, 0, 0, 0});
+        collections++;
+    }
+
+    // Swaps the variables at levels i and i + 1 in place: every node keeps
+    // its function, so edges held outside stay valid.
+    void swap_levels(uint32_t i) {
+        uint32_t x = var_at[i], y = var_at[i + 1];
+        std::vector<uint32_t> moved;
+        for(const auto& [k, n] : unique[x])
+            if(var_of(nodes[n].low) == y || var_of(nodes[n].high) == y)
+                moved.push_back(n);
+        spend(moved.size());
+        for(uint32_t n : moved)
+            unique[x].erase(key(nodes[n].low, nodes[n].high));
+        std::swap(var_at[i], var_at[i + 1]);
+        level[x] = i + 1;
+        level[y] = i;
+
+        for(uint32_t n : moved) {
+            BddEdge f0 = nodes[n].low, f1 = nodes[n].high;
+            BddEdge low = find_or_add(x, cofactor(f0, y, false), cofactor(f1, y, false));
+            BddEdge high = find_or_add(x, cofactor(f0, y, true), cofactor(f1, y, true));
+            refs[node(low)]++;
+            refs[node(high)]++;
+            nodes[n] = {y, low, high};
+            unique[y].emplace(key(low, high), n);
+            for(BddEdge c : {f0, f1})
+                if(--refs[node(c)] == 0)
+                    free_node(node(c));
+        }
+    }
+
+    // Sifting: each variable, largest level first, is moved down and then
+    // up through the levels and left where the BDD was smallest. A direction
+    // is abandoned once the size grows past max_growth times the best seen
+    // or the variable used up its sift_max_swaps swaps.
+    void sift(double max_growth = 1.2) {
+        collect();
+        std::vector<uint32_t> order(var_at.size());
+        for(uint32_t v = 0; v < order.size(); v++)
+            order[v] = v;
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return unique[a].size() > unique[b].size(); });
+        order.resize(std::min(order.size(), sift_max_vars));
+        uint32_t n_levels = uint32_t(var_at.size());
+        for(uint32_t v : order) {
+            size_t best = live(), swaps = 0;
+            uint32_t best_level = level[v];
+            auto open = [&] { return live() <= max_growth * best && swaps < sift_max_swaps && !overflow; };
+            while(level[v] + 1 < n_levels && open()) {
+                swap_levels(level[v]);
+                swaps++;
+                if(live() < best) {
+                    best = live();
+                    best_level = level[v];
+                }
+            }
+            while(level[v] > 0 && (level[v] > best_level || open())) {
+                swap_levels(level[v] - 1);
+                swaps++;
+                if(live() < best) {
+                    best = live();
+                    best_level = level[v];
+                }
+            }
+            while(level[v] < best_level)
+                swap_levels(level[v]);
+        }
+        cache.assign(cache.size(), CacheEntry{NoOp, 0, 0, 0});
+        reorderings++;
+    }
+
+    // Called between operations, when every edge in use is protected.
+    void checkpoint() {
+        if(live() < gc_threshold)
+            return;
+        collect();
+        if(reorder && live() >= reorder_threshold && var_at.size() <= reorder_max_vars) {
+            sift();
+            reorder_threshold = std::max(reorder_threshold, 2 * live());
+        }
+        gc_threshold = std::max(gc_threshold, 2 * live());
+    }
+
+    // Builds the BDD of f bottom-up over its cone. Intermediate results are
+    // released after their last parent, so they can be collected. The result
+    // is protected; check `overflow` before using it.
+    BddEdge from_formula(const FormulaPtr& f) {
+        std::vector<uint32_t> order = ::cone({f});
+        std::vector<uint32_t> uses(store().nodes.size(), 0);
+        for(uint32_t id : order) {
+            FormulaPtr g{id};
+            if(is<Not>(g))
+                uses[as<Not>(g).subformula.id]++;
+            else if(is<Binary>(g)) {
+                uses[as<Binary>(g).left.id]++;
+                uses[as<Binary>(g).right.id]++;
+            }
+        }
+        std::vector<BddEdge> edges(store().nodes.size(), False);
+        auto operand = [&](const FormulaPtr& c) {
+            BddEdge e = edges[c.id];
+            if(--uses[c.id] == 0)
+                release(e);
+            return e;
+        };
+        for(uint32_t id : order) {
+            const Formula& n = *FormulaPtr{id};
+            BddEdge e = False;
+            if(std::holds_alternative<::True>(n))
+                e = True;
+            else if(std::holds_alternative<Atom>(n))
+                e = input(std::get<Atom>(n).var);
+            else if(std::holds_alternative<Not>(n))
+                e = operand(std::get<Not>(n).subformula) ^ 1;
+            else if(std::holds_alternative<Binary>(n)) {
+                const Binary& b = std::get<Binary>(n);
+                BddEdge l = operand(b.left), r = operand(b.right);
+                switch(b.type) {
+                    case Binary::And:  e = apply_and(l, r); break;
+                    case Binary::Or:   e = apply_or(l, r); break;
+                    case Binary::Impl: e = apply_or(l ^ 1, r); break;
+                    case Binary::Eq:   e = apply_xor(l, r) ^ 1; break;
+                    case Binary::Xor:  e = apply_xor(l, r); break;
+                    case Binary::Nand: e = apply_and(l, r) ^ 1; break;
+                    case Binary::Nor:  e = apply_or(l, r) ^ 1; break;
+                }
+            }
+            if(overflow)
+                return False;
+            edges[id] = e;
+            protect(e);
+            checkpoint();
+        }
+        return edges[f.id];
+    }
+
+    // Assignment along a path from e to True, as (VarTable variable, value)
+    // pairs; variables off the path are free. e must not be False.
+    std::vector<std::pair<Var, bool>> satisfying_path(BddEdge e) const {
+        std::vector<std::pair<Var, bool>> path;
+        while(node(e) != 0) {
+            const Node& n = nodes[node(e)];
+            BddEdge low = n.low ^ (e & 1);
+            bool value = low == False;
+            path.push_back({input_var[n.var], value});
+            e = value ? n.high ^ (e & 1) : low;
+        }
+        return path;
+    }
+};
+
+#endif
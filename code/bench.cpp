@@ -0,0 +1,336 @@
+#include "jsonGraph.hpp"
+#include "dimacs.hpp"
+#include "pipeline.hpp"
+
+#include <bits/stdc++.h>
+#include <sys/resource.h>
+
+// Stage benchmarks over a generated corpus of formula pairs. Every stage of
+// the parse -> NNF -> CNF -> DIMACS -> solve pipeline is timed on its own;
+// results go to a JSON-lines file (one record per instance and stage) so two
+// versions can be compared, and a summary table goes to stdout.
+
+//Allocation counting. Kept out of line: once inlined, GCC pairs the malloc
+//with delete expressions and warns about a mismatch.
+static std::atomic<uint64_t> alloc_count{0}, alloc_bytes{0};
+
+__attribute__((noinline)) void* operator new(size_t n) {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(n, std::memory_order_relaxed);
+    if(void* p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t n) { return operator new(n); }
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
+long peak_rss_kb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+//Generators. Atoms are lowercase names, so they never clash with the constants T and F.
+std::string atom_name(size_t i) {
+    std::string s;
+    do {
+        s += char('a' + i % 26);
+        i /= 26;
+    } while(i);
+    return s;
+}
+
+std::string and_(const std::string& a, const std::string& b) { return "(" + a + "&" + b + ")"; }
+std::string or_(const std::string& a, const std::string& b) { return "(" + a + "|" + b + ")"; }
+std::string not_(const std::string& a) { return "~" + a; }
+std::string xor_sop(const std::string& a, const std::string& b) { return or_(and_(a, not_(b)), and_(not_(a), b)); }
+std::string xor_pos(const std::string& a, const std::string& b) { return and_(or_(a, b), not_(and_(a, b))); }
+
+struct Instance {
+    std::string generator;
+    size_t size;
+    std::string f, g;
+};
+
+// Two unrelated random formulas with `size` operators over sqrt(size) atoms;
+// the pair is almost always not equivalent.
+Instance random_pair(size_t size, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    size_t n_atoms = std::max<size_t>(2, size_t(std::sqrt(double(size))));
+    auto formula = [&] {
+        std::vector<std::string> pool;
+        for(size_t i = 0; i < size + 1; i++)
+            pool.push_back((rng() & 1 ? "~" : "") + atom_name(rng() % n_atoms));
+        while(pool.size() > 1) {
+            size_t i = rng() % pool.size();
+            std::swap(pool[i], pool.back());
+            std::string b = std::move(pool.back());
+            pool.pop_back();
+            std::string& a = pool[rng() % pool.size()];
+            a = rng() & 1 ? and_(a, b) : or_(a, b);
+            if(rng() % 4 == 0)
+                a = not_(a);
+        }
+        return pool[0];
+    };
+    std::string f = formula();
+    return {"random", size, f, formula()};
+}
+
+// Carry out of a `bits`-wide ripple-carry adder, with the carry written as
+// a majority on one side and through the sum xor on the other.
+Instance adder_pair(size_t bits) {
+    std::string cf = "cin", cg = "cin";
+    for(size_t i = 0; i < bits; i++) {
+        std::string a = "x" + atom_name(i), b = "y" + atom_name(i);
+        cf = or_(and_(a, b), and_(cf, or_(a, b)));
+        cg = or_(and_(a, b), and_(cg, xor_sop(a, b)));
+    }
+    return {"adder", bits, cf, cg};
+}
+
+// Product bit `bits - 1` of a `bits` x `bits` array multiplier, reducing each
+// column with full adders built from two different xor forms. Formulas are
+// trees, so the text grows exponentially with the width.
+Instance multiplier_pair(size_t bits) {
+    auto product_bit = [&](auto&& xor2) {
+        std::vector<std::vector<std::string>> column(bits);
+        for(size_t i = 0; i < bits; i++)
+            for(size_t j = 0; i + j < bits; j++)
+                column[i + j].push_back(and_("x" + atom_name(i), "y" + atom_name(j)));
+        for(size_t k = 0; k + 1 < bits; k++)
+            while(column[k].size() > 1) {
+                std::string x = column[k].back(); column[k].pop_back();
+                std::string y = column[k].back(); column[k].pop_back();
+                if(column[k].empty()) {
+                    column[k].push_back(xor2(x, y));
+                    column[k + 1].push_back(and_(x, y));
+                    continue;
+                }
+                std::string z = column[k].back(); column[k].pop_back();
+                column[k].push_back(xor2(xor2(x, y), z));
+                column[k + 1].push_back(or_(and_(x, y), and_(z, or_(x, y))));
+            }
+        std::vector<std::string>& last = column[bits - 1];
+        while(last.size() > 1) {
+            std::string x = last.back(); last.pop_back();
+            last.back() = xor2(last.back(), x);
+        }
+        return last[0];
+    };
+    return {"multiplier", bits, product_bit(xor_sop), product_bit(xor_pos)};
+}
+
+// Parity of `n` atoms as a balanced xor tree, split in halves on one side and
+// at a third on the other.
+Instance parity_pair(size_t n) {
+    std::function<std::string(size_t, size_t, bool)> parity = [&](size_t lo, size_t hi, bool halves) {
+        if(hi - lo == 1)
+            return atom_name(lo);
+        size_t mid = halves ? lo + (hi - lo) / 2 : lo + std::max<size_t>(1, (hi - lo) / 3);
+        std::string l = parity(lo, mid, halves), r = parity(mid, hi, halves);
+        return halves ? xor_sop(l, r) : xor_pos(l, r);
+    };
+    return {"parity", n, parity(0, n, true), parity(0, n, false)};
+}
+
+//Measurement
+static size_t check_failures = 0;
+
+struct StageResult {
+    std::string stage;
+    double ms = 0;
+    uint64_t allocs = 0, bytes = 0;
+    size_t items = 0;
+};
+
+// `prepare` runs before every repeat, outside the timing.
+template <class Prepare, class Fn>
+StageResult measure(const std::string& stage, size_t repeat, Prepare&& prepare, Fn&& fn) {
+    StageResult r;
+    r.stage = stage;
+    r.ms = std::numeric_limits<double>::max();
+    for(size_t k = 0; k < repeat; k++) {
+        prepare();
+        uint64_t count = alloc_count.load(), bytes = alloc_bytes.load();
+        auto start = std::chrono::steady_clock::now();
+        size_t items = fn();
+        r.ms = std::min(r.ms, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        if(k == 0) {
+            r.items = items;
+            r.allocs = alloc_count.load() - count;
+            r.bytes = alloc_bytes.load() - bytes;
+        }
+    }
+    return r;
+}
+
+template <class Fn>
+StageResult measure(const std::string& stage, size_t repeat, Fn&& fn) {
+    return measure(stage, repeat, [] {}, fn);
+}
+
+// Runs every stage on one instance. Each stage works on the output of the
+// previous one; the time is the fastest of `repeat` runs, items and
+// allocations are those of the first. Stages that build formulas start each
+// run from a freshly parsed store, so no run finds its nodes hash-consed.
+std::vector<StageResult> run_instance(const Instance& inst, size_t repeat, size_t budget, const std::string& dir) {
+    std::vector<StageResult> stages;
+    store().clear();
+    FormulaPtr f, g;
+    stages.push_back(measure("parse", repeat, [&] {
+        store().clear();
+        f = Parser(inst.f).parse_string_into_formula();
+        g = Parser(inst.g).parse_string_into_formula();
+        return inst.f.size() + inst.g.size();
+    }));
+    if(!f || !g)
+        return stages;
+
+    FormulaPtr miter = make_miter(f, g), miter_nnf;
+    stages.push_back(measure("nnf", repeat, [&] {
+        store().clear();
+        f = Parser(inst.f).parse_string_into_formula();
+        g = Parser(inst.g).parse_string_into_formula();
+        miter = make_miter(f, g);
+    }, [&] {
+        size_t before = store().nodes.size();
+        miter_nnf = nnf(miter);
+        return store().nodes.size() - before;
+    }));
+    NormalForm distributed, cleaned;
+    stages.push_back(measure("distribute", repeat, [&] {
+        distributed = distribute(miter_nnf, budget);
+        return distributed.size();
+    }));
+    NormalForm scratch;
+    stages.push_back(measure("cnf_clean", repeat, [&] { scratch = distributed; }, [&] {
+        cleaned = cnf_clean(std::move(scratch));
+        return distributed.size();
+    }));
+
+    EncodedCnf encoded;
+    stages.push_back(measure("tseitin", repeat, [&] {
+        encoded = encode(miter, CnfEncoding::PlaistedGreenbaum, budget);
+        return encoded.cnf.size();
+    }));
+    NormalForm simplified;
+    stages.push_back(measure("preprocess", repeat, [&] {
+        simplified = Preprocessor().run(encoded.cnf);
+        return encoded.cnf.size();
+    }));
+    std::string path = dir + "/bench_" + inst.generator + "_" + std::to_string(inst.size) + ".cnf";
+    stages.push_back(measure("make_dimacs", repeat, [&] { return write_dimacs(path, encoded.cnf); }));
+    std::remove(path.c_str());
+
+    stages.push_back(measure("to_json", repeat, [&] {
+        JsonGraph graph;
+        return graph.to_json(f, 0, 64).at("nodes").size();
+    }));
+    stages.push_back(measure("solve", repeat, [&] {
+        solve(simplified);
+        return simplified.size();
+    }));
+
+    // Exhaustive comparison on four threads, of f against g and against g
+    // with its last truth-table row flipped; both answers must match the
+    // single-threaded ones.
+    AtomSet atoms;
+    getAtoms(f, atoms);
+    getAtoms(g, atoms);
+    if(atoms.size() <= 22) {
+        FormulaPtr last_row = ptr(True{});
+        for(const auto& name : atoms)
+            last_row = ptr(Binary{Binary::And, last_row, ptr(Atom{name})});
+        std::vector<FormulaPtr> targets = {g, ptr(Binary{Binary::Xor, g, last_row})};
+        stages.push_back(measure("truth_table", repeat, [&] {
+            Valuation cex;
+            for(const FormulaPtr& t : targets)
+                exhaustive_difference(f, t, cex, 4);
+            return targets.size() << atoms.size();
+        }));
+        for(const FormulaPtr& t : targets) {
+            Valuation one, many;
+            bool d1 = exhaustive_difference(f, t, one, 1), dn = exhaustive_difference(f, t, many, 4);
+            if(d1 != dn || one != many) {
+                std::cout << "truth_table: " << inst.generator << " " << inst.size
+                          << " differs between one and four threads" << std::endl;
+                check_failures++;
+            }
+        }
+    }
+    return stages;
+}
+
+int main(int argc, char** argv) {
+    //Options
+    std::string out_file = "bench.jsonl", label = "current", dir = ".", only;
+    size_t repeat = 3, scale = 1, budget = DistributeBudget;
+    for(int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if(arg == "--out" && a + 1 < argc)
+            out_file = argv[++a];
+        else if(arg == "--label" && a + 1 < argc)
+            label = argv[++a];
+        else if(arg == "--dir" && a + 1 < argc)
+            dir = argv[++a];
+        else if(arg == "--only" && a + 1 < argc)
+            only = argv[++a];
+        else if(arg == "--repeat" && a + 1 < argc)
+            repeat = std::max<size_t>(1, std::stoul(argv[++a]));
+        else if(arg == "--scale" && a + 1 < argc)
+            scale = std::max<size_t>(1, std::stoul(argv[++a]));
+        else if(arg == "--dist-budget" && a + 1 < argc)
+            budget = std::stoull(argv[++a]);
+        else {
+            std::cout << "Usage: ./bench [--out bench.jsonl] [--label name] [--dir tmpdir] [--only generator]"
+                         " [--repeat N] [--scale N] [--dist-budget N]" << std::endl;
+            return 1;
+        }
+    }
+
+    //Corpus; --scale multiplies the size parameters
+    std::vector<Instance> corpus;
+    for(size_t size : {100, 1000, 10000})
+        corpus.push_back(random_pair(size * scale, size));
+    for(size_t bits : {16, 64, 256})
+        corpus.push_back(adder_pair(bits * scale));
+    for(size_t bits : {3, 4, 5})
+        corpus.push_back(multiplier_pair(bits + scale - 1));
+    for(size_t n : {16, 20, 64, 256})
+        corpus.push_back(parity_pair(n * scale));
+
+    std::ofstream out(out_file);
+    if(!out) {
+        std::cout << "Cannot open " << out_file << std::endl;
+        return 1;
+    }
+    std::cout << std::left << std::setw(12) << "generator" << std::setw(8) << "size" << std::setw(13) << "stage"
+              << std::right << std::setw(12) << "ms" << std::setw(12) << "items" << std::setw(14) << "items/s"
+              << std::setw(12) << "allocs" << std::setw(12) << "peak KB" << std::endl;
+    for(const Instance& inst : corpus) {
+        if(!only.empty() && inst.generator != only)
+            continue;
+        for(const StageResult& r : run_instance(inst, repeat, budget, dir)) {
+            double per_s = r.ms > 0 ? r.items / (r.ms / 1000) : 0;
+            long rss = peak_rss_kb();
+            out << json{
+                {"label", label}, {"generator", inst.generator}, {"size", inst.size}, {"stage", r.stage},
+                {"ms", r.ms}, {"items", r.items}, {"items_per_s", per_s},
+                {"allocs", r.allocs}, {"alloc_bytes", r.bytes}, {"peak_rss_kb", rss}
+            }.dump() << "\n";
+            std::cout << std::left << std::setw(12) << inst.generator << std::setw(8) << inst.size << std::setw(13) << r.stage
+                      << std::right << std::fixed << std::setprecision(3) << std::setw(12) << r.ms << std::setw(12) << r.items
+                      << std::setprecision(0) << std::setw(14) << per_s << std::setw(12) << r.allocs << std::setw(12) << rss << std::endl;
+        }
+        out.flush();
+    }
+    if(check_failures) {
+        std::cout << check_failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
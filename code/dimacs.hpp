@@ -1,33 +1,187 @@
+#ifndef DIMACS_H
+#define DIMACS_H
+
 #include "normalform.hpp"
 
-void make_dimacs(std::string name, NormalForm cnf) {
-    std::map<std::string, int> literal_map;
-    int n_clauses = 0;
-    int i = 1;
-    for(auto &clause : cnf) {
-        for(auto &literal : clause) {
-            if(!literal_map.count(literal.name)) {
-                literal_map[literal.name] = i;
-                i++;
-            }
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+enum class Compression { None, Gzip, Zstd };
+
+Compression compression_of(const std::string& path) {
+    auto ends_with = [&](const char* suffix) {
+        size_t n = strlen(suffix);
+        return path.size() >= n && path.compare(path.size() - n, n, suffix) == 0;
+    };
+    if(ends_with(".gz"))
+        return Compression::Gzip;
+    if(ends_with(".zst"))
+        return Compression::Zstd;
+    return Compression::None;
+}
+
+std::string shell_quote(const std::string& s) {
+    std::string q = "'";
+    for(char c : s)
+        q += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    return q + "'";
+}
+
+// True if the gzip / zstd tool is on PATH. Each tool is looked up once per
+// process. The first lookup also ignores SIGPIPE for the whole process, so
+// a compressor that exits early fails the write instead of killing us.
+bool compressor_available(Compression c) {
+    static const bool sigpipe_ignored = signal(SIGPIPE, SIG_IGN) != SIG_ERR;
+    static const bool gzip = std::system("command -v gzip > /dev/null 2>&1") == 0;
+    static const bool zstd = std::system("command -v zstd > /dev/null 2>&1") == 0;
+    (void)sigpipe_ignored;
+    return c == Compression::Gzip ? gzip : c == Compression::Zstd ? zstd : true;
+}
+
+// Buffered DIMACS output. Plain files are written directly, .gz and .zst
+// files are piped through the gzip / zstd command line tools, which must be
+// on PATH.
+struct DimacsWriter {
+    FILE* file = nullptr;
+    bool piped = false;
+    // Set by a short write or a failed close (including the compressor's
+    // exit status).
+    bool failed = false;
+    std::vector<char> buffer = std::vector<char>(1 << 16);
+    size_t used = 0;
+    size_t bytes = 0;
+
+    explicit DimacsWriter(const std::string& path) {
+        Compression c = compression_of(path);
+        piped = c != Compression::None;
+        if(!piped)
+            file = fopen(path.c_str(), "wb");
+        else if(compressor_available(c))
+            file = popen(((c == Compression::Gzip ? "gzip -c > " : "zstd -q -c > ") + shell_quote(path)).c_str(), "w");
+    }
+
+    ~DimacsWriter() { close(); }
+
+    bool ok() const { return file != nullptr && !failed; }
+
+    void flush() {
+        if(used && file && fwrite(buffer.data(), 1, used, file) != used)
+            failed = true;
+        bytes += used;
+        used = 0;
+    }
+
+    // Returns false if anything went wrong since the writer was opened.
+    bool close() {
+        if(!file)
+            return !failed;
+        flush();
+        int status = piped ? pclose(file) : fclose(file);
+        if(status != 0)
+            failed = true;
+        file = nullptr;
+        return !failed;
+    }
+
+    void put(char c) {
+        if(used == buffer.size())
+            flush();
+        buffer[used++] = c;
+    }
+
+    void number(int64_t n) {
+        if(used + 21 > buffer.size())
+            flush();
+        if(n < 0) {
+            buffer[used++] = '-';
+            n = -n;
         }
-        n_clauses++;
+        char digits[20];
+        int k = 0;
+        do {
+            digits[k++] = char('0' + n % 10);
+            n /= 10;
+        } while(n);
+        while(k)
+            buffer[used++] = digits[--k];
+    }
+
+    void text(const char* s) {
+        while(*s)
+            put(*s++);
+    }
+
+    void header(size_t n_vars, size_t n_clauses) {
+        text("p cnf ");
+        number(int64_t(n_vars));
+        put(' ');
+        number(int64_t(n_clauses));
+        put('\n');
     }
 
-    int n_literals = literal_map.size();
-    std::string output_string = "p cnf " + std::to_string(n_literals) + " " + std::to_string(n_clauses) + "\n";
-    std::string one_clause = "";
-    for(auto &clause : cnf) {
-        one_clause = "";
-        for(auto lit : clause) {
-            if(!lit.pos)
-                one_clause.append("-");
-            one_clause += std::to_string(literal_map.at(lit.name));
-            one_clause.append(" ");
+    void clause(const Lit* first, const Lit* last, const std::vector<int>& dimacs_var) {
+        for(const Lit* l = first; l != last; l++) {
+            int64_t v = dimacs_var[lit_var(*l)];
+            number(lit_neg(*l) ? -v : v);
+            put(' ');
         }
-        one_clause += "0\n";
-        output_string += one_clause;
+        put('0');
+        put('\n');
     }
+};
+
+// Renumbers variables densely from 1 in order of first occurrence.
+struct DimacsNumbering {
+    std::vector<int> dimacs_var;
+    int n_vars = 0;
+    size_t n_clauses = 0;
+
+    void see(const Lit* first, const Lit* last) {
+        for(const Lit* l = first; l != last; l++) {
+            Var v = lit_var(*l);
+            if(v >= dimacs_var.size())
+                dimacs_var.resize(std::max<size_t>(v + 1, vars().size()), 0);
+            if(!dimacs_var[v])
+                dimacs_var[v] = ++n_vars;
+        }
+        n_clauses++;
+    }
+};
+
+// Streams the clauses of produce(emit), where emit(const Lit*, const Lit*)
+// is called once per clause, to `path`. The producer is run twice, counting
+// variables and clauses for the header on the first pass, so it must yield
+// the same clauses both times. Returns the number of bytes written, or 0 if
+// the file could not be written.
+template<typename Producer>
+size_t stream_dimacs(const std::string& path, Producer&& produce) {
+    TRACE_SCOPE("make_dimacs");
+    DimacsWriter out(path);
+    if(!out.ok())
+        return 0;
+    DimacsNumbering numbering;
+    produce([&](const Lit* first, const Lit* last) { numbering.see(first, last); });
+    out.header(size_t(numbering.n_vars), numbering.n_clauses);
+    produce([&](const Lit* first, const Lit* last) { out.clause(first, last, numbering.dimacs_var); });
+    if(!out.close())
+        return 0;
+    TRACE_COUNT(BytesWritten, out.bytes);
+    return out.bytes;
+}
+
+size_t write_dimacs(const std::string& path, const NormalForm& cnf) {
+    return stream_dimacs(path, [&](auto&& emit) {
+        for(ClauseView clause : cnf)
+            emit(clause.begin(), clause.end());
+    });
+}
+
+// Returns false if the file could not be written.
+bool make_dimacs(const std::string& name, const NormalForm& cnf, Compression compression = Compression::None) {
+    const char* suffix[] = {".cnf", ".cnf.gz", ".cnf.zst"};
+    return write_dimacs(name + suffix[int(compression)], cnf) != 0;
+}
 
-    std::ofstream(name + ".cnf") << output_string;
-}
\ No newline at end of file
+#endif
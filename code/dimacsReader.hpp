@@ -0,0 +1,230 @@
+#ifndef DIMACS_READER_H
+#define DIMACS_READER_H
+
+#include "dimacs.hpp"
+
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Clause database read from a DIMACS file. DIMACS variable k maps to Var
+// first_var + k - 1. Variables must not exceed the header's count, nor
+// MaxVars without one.
+struct DimacsFile {
+    static constexpr size_t MaxVars = size_t(1) << 24;
+
+    NormalForm cnf;
+    Var first_var = 0;
+    size_t declared_vars = 0, declared_clauses = 0, max_var = 0;
+    size_t bytes = 0;
+    double seconds = 0;
+    std::string error;
+
+    bool ok() const { return error.empty(); }
+    double mb_per_s() const { return seconds > 0 ? double(bytes) / 1e6 / seconds : 0; }
+
+    // Registers DIMACS variable k in the VarTable under the name "k". Reading
+    // leaves the VarTable alone, so call this before the clauses meet
+    // anything that names or allocates variables (printing, cnf_clean,
+    // encoding formulas).
+    void name_vars() const {
+        size_t n_vars = std::max(max_var, declared_vars);
+        for(size_t k = vars().size() - first_var + 1; k <= n_vars; k++)
+            vars().add(std::to_string(k), false);
+    }
+};
+
+// Hand-rolled scanner over [p, end); never reads past end. Input can be fed
+// in pieces that end at a line break, with `offset` the position of `start`
+// in the file; finish() closes the last clause.
+struct DimacsScanner {
+    const char* start;
+    const char* p;
+    const char* end;
+    size_t offset = 0;
+    size_t var_limit = DimacsFile::MaxVars;
+    bool stopped = false;
+
+    static bool space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+    void skip_space() {
+        while(p < end && space(*p))
+            p++;
+    }
+
+    void skip_line() {
+        const void* nl = memchr(p, '\n', size_t(end - p));
+        p = nl ? static_cast<const char*>(nl) + 1 : end;
+    }
+
+    bool number(int64_t& n) {
+        bool negative = p < end && *p == '-';
+        if(negative)
+            p++;
+        if(p == end || *p < '0' || *p > '9')
+            return false;
+        // Saturates instead of wrapping, so oversized numbers fail the bounds checks.
+        uint64_t v = 0;
+        while(p < end && *p >= '0' && *p <= '9') {
+            uint64_t digit = uint64_t(*p++ - '0');
+            v = v > (INT64_MAX - digit) / 10 ? INT64_MAX : v * 10 + digit;
+        }
+        n = negative ? -int64_t(v) : int64_t(v);
+        return true;
+    }
+
+    bool parse(DimacsFile& file) {
+        int64_t n = 0;
+        while(!stopped) {
+            skip_space();
+            if(p == end)
+                break;
+            if(*p == 'c') {
+                skip_line();
+                continue;
+            }
+            if(*p == '%') {
+                stopped = true;
+                break;
+            }
+            if(*p == 'p') {
+                p++;
+                skip_space();
+                if(end - p < 3 || memcmp(p, "cnf", 3) != 0)
+                    return fail(file, "expected 'p cnf'");
+                p += 3;
+                int64_t v = 0, c = 0;
+                skip_space();
+                bool ok = number(v);
+                skip_space();
+                if(!ok || !number(c) || v < 0 || c < 0)
+                    return fail(file, "malformed header");
+                if(size_t(v) > DimacsFile::MaxVars)
+                    return fail(file, "more than " + std::to_string(DimacsFile::MaxVars) + " variables declared");
+                file.declared_vars = size_t(v);
+                file.declared_clauses = size_t(c);
+                var_limit = file.declared_vars;
+                // Every clause takes at least two bytes, which bounds a bogus count.
+                size_t reserved = std::min(file.declared_clauses, size_t(end - p) / 2);
+                file.cnf.reserve(reserved, 3 * reserved);
+                continue;
+            }
+            if(!number(n))
+                return fail(file, "unexpected character");
+            if(n == 0) {
+                file.cnf.end_clause();
+                continue;
+            }
+            size_t v = size_t(n < 0 ? -n : n);
+            if(v > var_limit)
+                return fail(file, "variable " + std::to_string(v) + " out of range (at most " + std::to_string(var_limit) + ")");
+            file.max_var = std::max(file.max_var, v);
+            file.cnf.append_lit(make_lit(file.first_var + Var(v - 1), n < 0));
+        }
+        return true;
+    }
+
+    void finish(DimacsFile& file) {
+        if(file.cnf.clause_open())
+            file.cnf.end_clause();
+    }
+
+    bool fail(DimacsFile& file, const std::string& what) {
+        file.error = what + " at byte " + std::to_string(offset + size_t(p - start));
+        return false;
+    }
+};
+
+// Parses the output of gzip / zstd in chunks cut at line breaks, so only
+// one chunk (or one overlong line) is held in memory at a time.
+bool read_dimacs_pipe(FILE* in, DimacsFile& file) {
+    std::vector<char> buffer;
+    size_t used = 0, chunk = 1 << 20;
+    DimacsScanner scanner{nullptr, nullptr, nullptr};
+    for(bool eof = false; !eof && !scanner.stopped;) {
+        buffer.resize(used + chunk);
+        size_t n = fread(buffer.data() + used, 1, chunk, in);
+        eof = n < chunk;
+        size_t size = used + n;
+        file.bytes += n;
+        const void* nl = size ? memrchr(buffer.data(), '\n', size) : nullptr;
+        size_t cut = eof ? size : nl ? size_t(static_cast<const char*>(nl) - buffer.data()) + 1 : 0;
+        scanner.start = scanner.p = buffer.data();
+        scanner.end = buffer.data() + cut;
+        if(!scanner.parse(file))
+            return false;
+        scanner.offset += cut;
+        used = size - cut;
+        memmove(buffer.data(), buffer.data() + cut, used);
+    }
+    scanner.finish(file);
+    return true;
+}
+
+// Reads plain files through a read-only memory mapping and .gz / .zst files
+// by streaming them through gzip / zstd. Variable names are not registered,
+// see DimacsFile::name_vars.
+DimacsFile read_dimacs(const std::string& path) {
+    auto start = std::chrono::steady_clock::now();
+    DimacsFile file;
+    file.first_var = Var(vars().size());
+
+    Compression c = compression_of(path);
+    if(c != Compression::None) {
+        FILE* in = popen(((c == Compression::Gzip ? "gzip -dc " : "zstd -q -dc ") + shell_quote(path)).c_str(), "r");
+        if(!in) {
+            file.error = "cannot run decompressor";
+            return file;
+        }
+        bool parsed = read_dimacs_pipe(in, file);
+        // Drain what a failed or stopped parse left, so the tool exits cleanly.
+        char rest[1 << 12];
+        for(size_t n; (n = fread(rest, 1, sizeof(rest), in)) > 0;)
+            file.bytes += n;
+        if(pclose(in) != 0 && parsed)
+            file.error = "cannot decompress " + path;
+        if(!file.ok())
+            return file;
+    }
+    else {
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if(fd < 0 || fstat(fd, &st) != 0) {
+            if(fd >= 0)
+                close(fd);
+            file.error = "cannot open " + path;
+            return file;
+        }
+        size_t size = size_t(st.st_size);
+        const char* begin = nullptr;
+        void* mapping = MAP_FAILED;
+        if(size > 0) {
+            mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapping == MAP_FAILED) {
+                close(fd);
+                file.error = "cannot map " + path;
+                return file;
+            }
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            begin = static_cast<const char*>(mapping);
+        }
+        close(fd);
+        file.bytes = size;
+
+        DimacsScanner scanner{begin, begin, begin + size};
+        bool parsed = scanner.parse(file);
+        if(parsed)
+            scanner.finish(file);
+        if(mapping != MAP_FAILED)
+            munmap(mapping, size);
+        if(!parsed)
+            return file;
+    }
+
+    file.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return file;
+}
+
+#endif
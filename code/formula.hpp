@@ -11,6 +11,10 @@
 #include <unordered_map>
 #include <set>
 #include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "trace.hpp"
 
 struct False;
 struct True;
@@ -19,18 +23,144 @@ struct Not;
 struct Binary;
 
 using Formula = std::variant<False, True, Atom, Not, Binary>;
-using FormulaPtr = std::shared_ptr<Formula>;
+
+// Handle to a node of the thread-local FormulaStore. Nodes are hash-consed,
+// so two handles are equal iff they denote structurally equal formulas.
+struct FormulaPtr {
+    static constexpr uint32_t None = UINT32_MAX;
+    uint32_t id = None;
+
+    FormulaPtr() = default;
+    explicit FormulaPtr(uint32_t i) : id(i) {}
+
+    explicit operator bool() const { return id != None; }
+    bool operator==(FormulaPtr o) const { return id == o.id; }
+    bool operator!=(FormulaPtr o) const { return id != o.id; }
+
+    const Formula& operator*() const;
+};
 
 struct False {};
 struct True {};
-struct Atom { std::string name; };
+struct Atom { std::string name; uint32_t var = 0; };
 struct Not { FormulaPtr subformula; };
 struct Binary {
-    enum Type { And, Or, Impl, Eq } type;
+    enum Type { And, Or, Impl, Eq, Xor, Nand, Nor } type;
     FormulaPtr left, right;
 };
 
-FormulaPtr ptr(const Formula& f) { return std::make_shared<Formula>(f); }
+using Var = uint32_t;
+
+// Interns atom names once; CNF literals refer to atoms by their Var.
+struct VarTable {
+    std::vector<std::string> names;
+    std::vector<bool> aux;
+    std::unordered_map<std::string, Var> ids;
+
+    size_t size() const { return names.size(); }
+    const std::string& name(Var v) const { return names[v]; }
+
+    Var add(const std::string& name, bool is_aux) {
+        Var v = Var(names.size());
+        names.push_back(name);
+        aux.push_back(is_aux);
+        ids.emplace(name, v);
+        return v;
+    }
+
+    Var intern(const std::string& name) {
+        auto it = ids.find(name);
+        return it != ids.end() ? it->second : add(name, false);
+    }
+
+    // Auxiliary variable whose name cannot clash with an existing atom.
+    Var fresh() {
+        std::string name = "_t" + std::to_string(names.size());
+        while(ids.count(name))
+            name += "_";
+        return add(name, true);
+    }
+
+    void clear() {
+        names.clear();
+        aux.clear();
+        ids.clear();
+    }
+};
+
+struct FormulaStore {
+    struct Key {
+        uint32_t op, left, right;
+        bool operator==(const Key& o) const { return op == o.op && left == o.left && right == o.right; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            uint64_t h = (uint64_t(k.left) << 32 | k.right) * 0x9E3779B97F4A7C15ull;
+            return h ^ (h >> 29) ^ k.op;
+        }
+    };
+    static constexpr uint32_t NotOp = 0xff;
+
+    std::vector<Formula> nodes;
+    std::vector<uint32_t> atom_nodes;
+    VarTable vars;
+    std::unordered_map<Key, uint32_t, KeyHash> unique;
+
+    FormulaStore() { clear(); }
+
+    void clear() {
+        nodes.clear();
+        atom_nodes.clear();
+        vars.clear();
+        unique.clear();
+        nodes.push_back(False{});
+        nodes.push_back(True{});
+    }
+
+    uint32_t intern(const Key& k, const Formula& f) {
+        auto [it, inserted] = unique.try_emplace(k, uint32_t(nodes.size()));
+        if(inserted) {
+            nodes.push_back(f);
+            TRACE_COUNT(NodesCreated, 1);
+        }
+        return it->second;
+    }
+
+    FormulaPtr make(const Formula& f) {
+        switch(f.index()) {
+            case 0: return FormulaPtr{0};
+            case 1: return FormulaPtr{1};
+            case 2: {
+                const std::string& name = std::get<Atom>(f).name;
+                Var v = vars.intern(name);
+                if(v >= atom_nodes.size())
+                    atom_nodes.resize(v + 1, FormulaPtr::None);
+                if(atom_nodes[v] == FormulaPtr::None) {
+                    atom_nodes[v] = uint32_t(nodes.size());
+                    nodes.push_back(Atom{name, v});
+                }
+                return FormulaPtr{atom_nodes[v]};
+            }
+            case 3:
+                return FormulaPtr{intern({NotOp, std::get<Not>(f).subformula.id, 0}, f)};
+            default: {
+                const Binary& b = std::get<Binary>(f);
+                return FormulaPtr{intern({uint32_t(b.type), b.left.id, b.right.id}, f)};
+            }
+        }
+    }
+};
+
+FormulaStore& store() {
+    thread_local FormulaStore s;
+    return s;
+}
+
+const Formula& FormulaPtr::operator*() const { return store().nodes[id]; }
+
+FormulaPtr ptr(const Formula& f) { return store().make(f); }
+
+VarTable& vars() { return store().vars; }
 
 template<typename T>
 bool is(const FormulaPtr& f) { return std::holds_alternative<T>(*f); }
@@ -41,58 +171,111 @@ T as(const FormulaPtr& f) { return std::get<T>(*f); }
 using Valuation = std::map<std::string, bool>;
 using AtomSet = std::set<std::string>;
 
+// Prints with an explicit stack of pending nodes and text pieces, so long
+// operator chains do not recurse.
 std::string print(const FormulaPtr& f) {
-    if(is<False>(f)) return "F";
-    if(is<True>(f))  return "T";
-    if(is<Atom>(f))  return as<Atom>(f).name;
-    if(is<Not>(f))   return "~" + print(as<Not>(f).subformula);
-    if(is<Binary>(f)) {
-        std::string sign;
-        switch(as<Binary>(f).type) {
-            case Binary::And:  sign = "&";   break;
-            case Binary::Or:   sign = "|";   break;
-            case Binary::Impl: sign = "->";  break;
-            case Binary::Eq:   sign = "<->"; break;
+    std::string out;
+    std::vector<std::pair<FormulaPtr, const char*>> stack = {{f, nullptr}};
+    while(!stack.empty()) {
+        auto [g, text] = stack.back();
+        stack.pop_back();
+        if(text) {
+            out += text;
+            continue;
+        }
+        if(is<False>(g))     out += "F";
+        else if(is<True>(g)) out += "T";
+        else if(is<Atom>(g)) out += std::get<Atom>(*g).name;
+        else if(is<Not>(g)) {
+            out += "~";
+            stack.push_back({std::get<Not>(*g).subformula, nullptr});
+        }
+        else if(is<Binary>(g)) {
+            const Binary& b = std::get<Binary>(*g);
+            const char* sign = "";
+            switch(b.type) {
+                case Binary::And:  sign = " & ";   break;
+                case Binary::Or:   sign = " | ";   break;
+                case Binary::Impl: sign = " -> ";  break;
+                case Binary::Eq:   sign = " <-> "; break;
+                case Binary::Xor:  sign = " ^ ";   break;
+                case Binary::Nand: sign = " ~& ";  break;
+                case Binary::Nor:  sign = " ~| ";  break;
+            }
+            out += "(";
+            stack.push_back({FormulaPtr{}, ")"});
+            stack.push_back({b.right, nullptr});
+            stack.push_back({FormulaPtr{}, sign});
+            stack.push_back({b.left, nullptr});
         }
-        return "(" + print(as<Binary>(f).left) + " " + sign + " " + print(as<Binary>(f).right) + ")";
     }
-    return "";
+    return out;
 }
 
-bool next(Valuation& v) {
-    auto it = begin(v);
-    while(it != end(v) && it->second) {
-        it->second = false;
-        it++;
+// Enumerates valuations of a set of atoms lazily, in Gray-code order: each
+// call to next() flips exactly one atom. row() is the truth-table row of the
+// current valuation, where atom k (in AtomSet order) is bit k. Enumeration
+// can start at any step, so a range of steps can be paged through.
+struct ValuationEnumerator {
+    std::vector<std::string> atoms;
+    Valuation v;
+    uint64_t step = 0;
+
+    explicit ValuationEnumerator(const AtomSet& set, uint64_t first_step = 0)
+        : atoms(begin(set), end(set)), step(first_step) {
+        uint64_t r = row();
+        for(size_t k = 0; k < atoms.size(); k++)
+            v[atoms[k]] = k < 64 && ((r >> k) & 1);
     }
 
-    if(it == end(v))
-        return false;
+    const Valuation& current() const { return v; }
+    uint64_t row() const { return step ^ (step >> 1); }
+    // Saturates at 2^64 - 1 steps for 64 or more atoms.
+    uint64_t count() const { return atoms.size() < 64 ? uint64_t(1) << atoms.size() : UINT64_MAX; }
 
-    return it->second = true;
-}
+    // Returns the index of the flipped atom, or -1 once every valuation was seen.
+    int next() {
+        if(step + 1 >= count())
+            return -1;
+        int k = __builtin_ctzll(++step);
+        v[atoms[k]] = !v[atoms[k]];
+        return k;
+    }
+};
 
-std::vector<Valuation> getValuations(const AtomSet& atoms) {
-    std::vector<Valuation> valuations;
-    Valuation v;
-    for(const auto& atom : atoms)
-        v[atom] = false;
-    do {
-        valuations.push_back(v);
-    } while(next(v));
-    
-    return valuations;
+// Ids of all nodes reachable from the roots, children before parents.
+// Hash-consing creates every node after its operands, so ascending id
+// order is a topological order.
+std::vector<uint32_t> cone(const std::vector<FormulaPtr>& roots) {
+    std::vector<uint32_t> order, stack;
+    std::vector<bool> seen(store().nodes.size(), false);
+    auto visit = [&](FormulaPtr f) {
+        if(f && !seen[f.id]) {
+            seen[f.id] = true;
+            stack.push_back(f.id);
+        }
+    };
+    for(const auto& r : roots)
+        visit(r);
+    while(!stack.empty()) {
+        FormulaPtr f{stack.back()};
+        stack.pop_back();
+        order.push_back(f.id);
+        if(is<Not>(f))
+            visit(std::get<Not>(*f).subformula);
+        else if(is<Binary>(f)) {
+            visit(std::get<Binary>(*f).left);
+            visit(std::get<Binary>(*f).right);
+        }
+    }
+    std::sort(begin(order), end(order));
+    return order;
 }
 
 void getAtoms(const FormulaPtr& f, AtomSet& atoms) {
-    if(is<Atom>(f))
-        atoms.insert(as<Atom>(f).name);
-    else if(is<Not>(f))
-        getAtoms(as<Not>(f).subformula, atoms);
-    else if(is<Binary>(f)) {
-        getAtoms(as<Binary>(f).left, atoms);
-        getAtoms(as<Binary>(f).right, atoms);
-    }
+    for(uint32_t id : cone({f}))
+        if(is<Atom>(FormulaPtr{id}))
+            atoms.insert(std::get<Atom>(*FormulaPtr{id}).name);
 }
 
 FormulaPtr make_miter(const FormulaPtr& l, const FormulaPtr& r) {
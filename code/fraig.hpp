@@ -0,0 +1,192 @@
+#ifndef FRAIG_H
+#define FRAIG_H
+
+#include "aig.hpp"
+#include "solver.hpp"
+
+#include <random>
+
+// SAT sweeping. Random simulation groups the nodes of an AIG into candidate
+// classes of (possibly complemented) equivalent nodes; every candidate is
+// proved or refuted with a conflict-bounded SAT call while the graph is
+// rebuilt into `out`, and proven nodes are merged into their representative.
+// Counterexamples become extra simulation patterns, so one refutation splits
+// every class it distinguishes before more SAT calls are spent on it.
+struct Fraig {
+    const Aig& src;
+    Aig out;
+    std::vector<AigLit> map;
+    std::vector<std::vector<uint64_t>> sim;
+    std::vector<uint32_t> order, processed;
+    std::unordered_map<uint64_t, uint32_t> classes;
+    size_t cex_bits = 64;
+    std::mt19937_64 rng;
+    Solver sat;
+    std::vector<Lit> node_lit;
+
+    uint64_t conflict_limit = 1000;
+    // Every refutation re-simulates the whole cone; past this many failed
+    // checks the rest of the graph is only rebuilt structurally.
+    size_t failed_limit = 256;
+    size_t proved = 0, refuted = 0, undecided = 0;
+
+    explicit Fraig(const Aig& aig, uint64_t seed = 1) : src(aig), map(aig.size(), Aig::False), sim(aig.size()), rng(seed) {}
+
+    // Signatures are normalized so that the first pattern is 0; a node and
+    // its complement then share a class.
+    bool phase(uint32_t n) const { return sim[n][0] & 1; }
+
+    uint64_t signature(uint32_t n) const {
+        uint64_t flip = phase(n) ? ~uint64_t(0) : 0, h = 0;
+        for(uint64_t w : sim[n])
+            h = (h ^ (w ^ flip)) * 0x9E3779B97F4A7C15ull;
+        return h;
+    }
+
+    bool same_class(uint32_t a, uint32_t b) const {
+        uint64_t flip = phase(a) != phase(b) ? ~uint64_t(0) : 0;
+        for(size_t w = 0; w < sim[a].size(); w++)
+            if(sim[a][w] != (sim[b][w] ^ flip))
+                return false;
+        return true;
+    }
+
+    void simulate_word(size_t w) {
+        for(uint32_t n : order)
+            if(n != 0 && src.is_and(n)) {
+                AigLit a = src.nodes[n].left, b = src.nodes[n].right;
+                sim[n][w] = (sim[Aig::node(a)][w] ^ (a & 1 ? ~uint64_t(0) : 0))
+                          & (sim[Aig::node(b)][w] ^ (b & 1 ? ~uint64_t(0) : 0));
+            }
+    }
+
+    // Adds the input values of a refuting model as one more pattern. Bits of
+    // the last word not yet filled stay 0, which is itself a valid pattern.
+    void add_counterexample() {
+        if(cex_bits == 64) {
+            for(uint32_t n : order)
+                sim[n].push_back(0);
+            cex_bits = 0;
+        }
+        size_t w = sim[0].size() - 1;
+        for(uint32_t n : order) {
+            if(!src.is_input(n) || Aig::node(map[n]) >= node_lit.size())
+                continue;
+            Lit x = node_lit[Aig::node(map[n])];
+            if(x != NoLit && sat.model_value(lit_var(x)))
+                sim[n][w] |= uint64_t(1) << cex_bits;
+        }
+        cex_bits++;
+        simulate_word(w);
+        classes.clear();
+        for(uint32_t p : processed)
+            classes.try_emplace(signature(p), p);
+    }
+
+    // Solver variables of encoded `out` nodes. One incremental solver serves
+    // every candidate check, so AND definitions are added once and learnt
+    // clauses carry over from one check to the next.
+    Lit sat_lit(AigLit a) {
+        node_lit.resize(out.size(), NoLit);
+        std::vector<uint32_t> stack = {Aig::node(a)};
+        while(!stack.empty()) {
+            uint32_t n = stack.back();
+            if(node_lit[n] != NoLit) {
+                stack.pop_back();
+                continue;
+            }
+            if(out.is_and(n) && n != 0) {
+                AigLit l = out.nodes[n].left, r = out.nodes[n].right;
+                if(node_lit[Aig::node(l)] == NoLit || node_lit[Aig::node(r)] == NoLit) {
+                    stack.push_back(Aig::node(l));
+                    stack.push_back(Aig::node(r));
+                    continue;
+                }
+            }
+            stack.pop_back();
+            Lit x = make_lit(sat.new_var(), false);
+            node_lit[n] = x;
+            if(n == 0)
+                sat.add_clause({lit_not(x)});
+            else if(out.is_and(n)) {
+                Lit l = node_lit[Aig::node(out.nodes[n].left)] ^ (out.nodes[n].left & 1);
+                Lit r = node_lit[Aig::node(out.nodes[n].right)] ^ (out.nodes[n].right & 1);
+                sat.add_clause({lit_not(x), l});
+                sat.add_clause({lit_not(x), r});
+                sat.add_clause({x, lit_not(l), lit_not(r)});
+            }
+        }
+        return node_lit[Aig::node(a)] ^ (a & 1);
+    }
+
+    // Decides whether out-literals a and b are equal with a bounded SAT call
+    // under an activation literal, which is retired afterwards.
+    SatResult prove_equal(AigLit a, AigLit b) {
+        Lit x = sat_lit(a), y = sat_lit(b);
+        Lit act = make_lit(sat.new_var(), false);
+        sat.add_clause({lit_not(act), x, y});
+        sat.add_clause({lit_not(act), lit_not(x), lit_not(y)});
+        sat.conflict_budget = sat.conflicts + conflict_limit;
+        SatResult result = sat.solve({act});
+        sat.add_clause({lit_not(act)});
+        if(result == SatResult::Unsat) {
+            sat.add_clause({lit_not(x), y});
+            sat.add_clause({x, lit_not(y)});
+        }
+        return result;
+    }
+
+    // Rebuilds the cone of the roots into `out`; lit(r) then maps a source
+    // literal to its swept counterpart.
+    void run(const std::vector<AigLit>& roots, size_t words = 4) {
+        TRACE_SCOPE("fraig");
+        order = src.cone(roots);
+        if(order.empty() || order[0] != 0)
+            order.insert(order.begin(), 0);
+        for(uint32_t n : order) {
+            sim[n].assign(words, 0);
+            if(src.is_input(n))
+                for(auto& w : sim[n])
+                    w = rng();
+        }
+        for(size_t w = 0; w < words; w++)
+            simulate_word(w);
+
+        for(uint32_t n : order) {
+            if(n == 0)
+                map[n] = Aig::False;
+            else if(src.is_input(n))
+                map[n] = out.input(src.input_var[n]);
+            else
+                map[n] = out.make_and(lit(src.nodes[n].left), lit(src.nodes[n].right));
+
+            while(refuted + undecided < failed_limit) {
+                auto it = classes.find(signature(n));
+                if(it == classes.end() || !same_class(it->second, n))
+                    break;
+                uint32_t r = it->second;
+                AigLit target = map[r] ^ (phase(n) != phase(r) ? 1 : 0);
+                if(map[n] == target)
+                    break;
+                SatResult result = prove_equal(map[n], target);
+                if(result == SatResult::Unsat) {
+                    map[n] = target;
+                    proved++;
+                    break;
+                }
+                if(result == SatResult::Unknown) {
+                    undecided++;
+                    break;
+                }
+                refuted++;
+                add_counterexample();
+            }
+            processed.push_back(n);
+            classes.try_emplace(signature(n), n);
+        }
+    }
+
+    AigLit lit(AigLit l) const { return map[Aig::node(l)] ^ (l & 1); }
+};
+
+#endif
@@ -1,4 +1,4 @@
-#include "formula.hpp"
+#include "simulation.hpp"
 #include "json.hpp"
 
 using json = nlohmann::json;
@@ -7,109 +7,102 @@ struct JsonGraph {
     int nextId = 1;
     json j = {{"nodes", json::array()}, {"edges", json::array()} };
 
-    std::unordered_map<const Formula*, int> gateIds;
+    std::unordered_map<uint32_t, int> gateIds;
     std::unordered_map<std::string, int> inputIds;
 
-    std::unordered_map<int, std::vector<bool>> truthVectors;
-
-    bool evaluate(const FormulaPtr& f, Valuation& v, int vId) {
-        if(is<False>(f))
-            return false;
-        if(is<True>(f))
-            return true;
-        if(is<Atom>(f)) {
-            std::string name = as<Atom>(f).name;
-            bool value = v[name];
-            int nodeId = inputIds[name];
-            truthVectors[nodeId][vId] = value;
-            return value;
-        }
-        if(is<Not>(f)) {
-            bool value = !evaluate(as<Not>(f).subformula, v, vId);
-            int nodeId = gateIds[f.get()];
-            truthVectors[nodeId][vId] = value;
-            return value;
-        }
-        if(is<Binary>(f)) {
-            bool evalL = evaluate(as<Binary>(f).left, v, vId);
-            bool evalR = evaluate(as<Binary>(f).right, v, vId);
-            bool value = false;
-            switch(as<Binary>(f).type) {
-                case Binary::And:  value = evalL && evalR; break;
-                case Binary::Or:   value = evalL || evalR; break;
-                case Binary::Impl: value = !evalL || evalR; break;
-                case Binary::Eq:   value = evalL == evalR; break;
-            }
-            int nodeId = gateIds[f.get()];
-            truthVectors[nodeId][vId] = value;
-            return value;
-        }
-        return false;
-    }
+    std::vector<uint32_t> formulaIds = {FormulaPtr::None};
 
     void add_node(const std::string &label, const std::string &type, int id, int dist) {
         json node = {{"id", id}, {"label", label}, {"type", type}, {"dist", dist}};
         j["nodes"].push_back(node);
     }
 
-    int ensure_input(const std::string &name, int dist) {
+    int ensure_input(const FormulaPtr &f, int dist) {
+        const std::string &name = std::get<Atom>(*f).name;
         auto it = inputIds.find(name);
         if (it != inputIds.end())
             return it->second;
 
         int id = nextId++;
         inputIds[name] = id;
+        formulaIds.push_back(f.id);
         add_node(name, "input", id, dist);
         return id;
     }
 
     int ensure_gate(const FormulaPtr &f, const std::string &label, int dist) {
-        const Formula* key = f.get();
-        auto it = gateIds.find(key);
+        auto it = gateIds.find(f.id);
         if (it != gateIds.end())
             return it->second;
 
         int id = nextId++;
-        gateIds[key] = id;
+        gateIds[f.id] = id;
+        formulaIds.push_back(f.id);
         add_node(label, "gate", id, dist);
         return id;
     }
 
-   void from_formula(const FormulaPtr &f, int parent_id, int dist) {
-        if (!f) return;
+    // Depth-first walk with an explicit stack; every occurrence of a node gets
+    // an edge to its parent, but a shared gate's operands are expanded once.
+    void from_formula(const FormulaPtr &f, int parent_id, int dist) {
+        struct Visit { FormulaPtr f; int parent_id, dist; };
+        std::vector<Visit> stack = {{f, parent_id, dist}};
+        while (!stack.empty()) {
+            Visit v = stack.back();
+            stack.pop_back();
+            if (!v.f) continue;
+
+            if (is<Atom>(v.f)) {
+                int this_id = ensure_input(v.f, v.dist);
+                if (v.parent_id != 0)
+                    j["edges"].push_back({this_id, v.parent_id});
+                continue;
+            }
 
-        if (is<Atom>(f)) {
-            std::string name = as<Atom>(f).name;
-            int this_id = ensure_input(name, dist);
-            if (parent_id != 0)
-                j["edges"].push_back({this_id, parent_id});
-        }
-        else if (is<Not>(f)) {
-            int this_id = ensure_gate(f, "NOT", dist);
-            if (parent_id != 0)
-                j["edges"].push_back({this_id, parent_id});
-            from_formula(as<Not>(f).subformula, this_id, dist + 1);
-        }
-        else if (is<Binary>(f)) {
-            auto b = as<Binary>(f);
-            std::string label;
-            switch(b.type) {
-                case Binary::And: label="AND"; break;
-                case Binary::Or:  label="OR";  break;
-                case Binary::Impl: label="IMPL"; break;
-                case Binary::Eq:  label="EQ";  break;
+            std::string label = "NOT";
+            if (is<Binary>(v.f)) {
+                switch(as<Binary>(v.f).type) {
+                    case Binary::And:  label="AND";  break;
+                    case Binary::Or:   label="OR";   break;
+                    case Binary::Impl: label="IMPL"; break;
+                    case Binary::Eq:   label="EQ";   break;
+                    case Binary::Xor:  label="XOR";  break;
+                    case Binary::Nand: label="NAND"; break;
+                    case Binary::Nor:  label="NOR";  break;
+                }
+            }
+            else if (!is<Not>(v.f))
+                continue;
+
+            bool expanded = gateIds.count(v.f.id);
+            int this_id = ensure_gate(v.f, label, v.dist);
+            if (v.parent_id != 0)
+                j["edges"].push_back({this_id, v.parent_id});
+            if (expanded)
+                continue;
+            if (is<Not>(v.f))
+                stack.push_back({as<Not>(v.f).subformula, this_id, v.dist + 1});
+            else {
+                stack.push_back({as<Binary>(v.f).right, this_id, v.dist + 1});
+                stack.push_back({as<Binary>(v.f).left, this_id, v.dist + 1});
             }
-            int this_id = ensure_gate(f, label, dist);
-            if (parent_id != 0)
-                j["edges"].push_back({this_id, parent_id});
-            from_formula(b.left, this_id, dist + 1);
-            from_formula(b.right, this_id, dist + 1);
         }
     }
 
-    json to_json(const FormulaPtr &f) {
+    static constexpr size_t RowLimit = size_t(1) << 20;
+
+    // Exports the graph with truth vectors for rows [first_row, first_row + max_rows)
+    // of the truth table, so large tables can be paged through. At most
+    // RowLimit rows are exported at once; with 64 or more atoms only the
+    // first 2^64 - 1 rows can be addressed, and "total" saturates there.
+    // With `gray` the page covers Gray-code steps instead, one input flipping
+    // per column, streamed through an IncrementalEvaluator; "rows"."index"
+    // then lists the truth-table row of every column.
+    json to_json(const FormulaPtr &f, size_t first_row = 0, size_t max_rows = SIZE_MAX, bool gray = false) {
+        TRACE_SCOPE("to_json");
         gateIds.clear();
-        inputIds.clear();;
+        inputIds.clear();
+        formulaIds = {FormulaPtr::None};
         j["nodes"].clear();
         j["edges"].clear();
         nextId = 1;
@@ -122,22 +115,54 @@ struct JsonGraph {
 
         AtomSet atoms;
         getAtoms(f, atoms);
-        std::vector<Valuation> valuations = getValuations(atoms);
-
-        int n = valuations.size();
-        for(auto &[_, id] : gateIds)
-            truthVectors[id] = std::vector<bool>(n, false);
-        for(auto &[_, id] : inputIds)
-            truthVectors[id] = std::vector<bool>(n, false);
+        std::vector<size_t> rank(vars().size());
+        size_t k = 0;
+        for(const auto& name : atoms)
+            rank[vars().intern(name)] = k++;
+
+        size_t n = atoms.size() < 64 ? size_t(1) << atoms.size() : SIZE_MAX;
+        size_t first = std::min(first_row, n);
+        size_t count = std::min({max_rows, n - first, RowLimit});
+        if(gray) {
+            std::vector<FormulaPtr> node_formulas;
+            for(auto& node : j["nodes"])
+                node_formulas.push_back(FormulaPtr{formulaIds[node["id"].get<int>()]});
+            std::vector<std::vector<bool>> valuations(node_formulas.size(), std::vector<bool>(count));
+            std::vector<uint64_t> index;
+            index.reserve(count);
+            for_each_valuation(f, first, count, [&](uint64_t row, const Valuation&, const IncrementalEvaluator& eval) {
+                for(size_t k = 0; k < node_formulas.size(); k++)
+                    valuations[k][index.size()] = eval[node_formulas[k]];
+                index.push_back(row);
+            });
+            size_t k = 0;
+            for(auto& node : j["nodes"]) {
+                if(node["type"] == "input")
+                    node["dist"] = max_dist;
+                node["valuation"] = valuations[k++];
+            }
+            j["rows"] = {{"first", first}, {"count", count}, {"total", n}, {"order", "gray"}, {"index", index}};
+            return j;
+        }
 
-        for(int i = 0; i < n; i++)
-            evaluate(f, valuations[i], i);
+        size_t first_word = first / 64;
+        size_t words = (first + count + 63) / 64 - first_word;
+        Simulation sim;
+        sim.run({f}, words, [&](Var v, uint64_t* out) {
+            exhaustive_pattern(rank[v], first_word, words, out);
+        });
 
+        size_t offset = first - first_word * 64;
         for(auto& node : j["nodes"]) {
             if(node["type"] == "input")
                 node["dist"] = max_dist;
-            node["valuation"] = truthVectors[node["id"]];
+            uint32_t id = formulaIds[node["id"].get<int>()];
+            std::vector<bool> valuation(count);
+            for(size_t i = 0; i < count; i++)
+                valuation[i] = sim.bit(id, offset + i);
+            node["valuation"] = valuation;
         }
+        j["rows"] = {{"first", first}, {"count", count}, {"total", n}, {"order", "natural"}};
 
         return j;
     }
@@ -1,74 +1,141 @@
+#ifndef NORMALFORM_H
+#define NORMALFORM_H
+
 #include "formula.hpp"
 
-struct Literal {
-    bool pos;
-    std::string name;
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <thread>
+
+// Literals are 2 * var + negated, with vars from the thread-local VarTable.
+using Lit = uint32_t;
+
+constexpr Lit NoLit = UINT32_MAX;
+
+Lit make_lit(Var v, bool negated) { return 2 * v + (negated ? 1 : 0); }
+Var lit_var(Lit l) { return l >> 1; }
+bool lit_neg(Lit l) { return l & 1; }
+Lit lit_not(Lit l) { return l ^ 1; }
+
+using Clause = std::vector<Lit>;
+
+// Read-only view of one clause of a NormalForm.
+struct ClauseView {
+    const Lit* first = nullptr;
+    const Lit* last = nullptr;
+
+    ClauseView() = default;
+    ClauseView(const Lit* f, const Lit* l) : first(f), last(l) {}
+
+    const Lit* begin() const { return first; }
+    const Lit* end() const { return last; }
+    const Lit* data() const { return first; }
+    size_t size() const { return size_t(last - first); }
+    bool empty() const { return first == last; }
+    Lit operator[](size_t i) const { return first[i]; }
+};
+
+// CNF stored flat: the literals of all clauses back to back in `lits`, clause
+// i spanning lits[start[i], start[i + 1]). Building or copying a CNF touches
+// two buffers instead of allocating a vector per clause.
+struct NormalForm {
+    std::vector<Lit> lits;
+    std::vector<size_t> start = {0};
+
+    struct iterator {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ClauseView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = ClauseView;
+
+        const NormalForm* cnf;
+        size_t i;
 
-    bool operator==(Literal const& o) const noexcept {
-        return pos == o.pos && name == o.name;
+        ClauseView operator*() const { return (*cnf)[i]; }
+        iterator& operator++() { i++; return *this; }
+        bool operator==(const iterator& o) const { return i == o.i; }
+        bool operator!=(const iterator& o) const { return i != o.i; }
+    };
+
+    size_t size() const { return start.size() - 1; }
+    bool empty() const { return size() == 0; }
+    size_t literals() const { return lits.size(); }
+
+    ClauseView operator[](size_t i) const { return {lits.data() + start[i], lits.data() + start[i + 1]}; }
+    iterator begin() const { return {this, 0}; }
+    iterator end() const { return {this, size()}; }
+
+    void reserve(size_t clauses, size_t literals = 0) {
+        start.reserve(clauses + 1);
+        lits.reserve(literals);
     }
 
-    bool operator<(Literal const& o) const noexcept {
-        if (name != o.name)
-            return name < o.name;
-        return pos < o.pos;
+    void clear() {
+        lits.clear();
+        start.assign(1, 0);
     }
-};
 
-using Clause = std::vector<Literal>;
-using NormalForm = std::vector<Clause>;
+    // A clause is built by appending literals and then closing it.
+    void append_lit(Lit l) { lits.push_back(l); }
+    template<typename It>
+    void append_lits(It first, It last) { lits.insert(lits.end(), first, last); }
+    void end_clause() { start.push_back(lits.size()); }
+    bool clause_open() const { return lits.size() != start.back(); }
 
-template<typename List>
-List concat(const List& l, const List& r) {
-    List result;
-    std::copy(begin(l), end(l), std::back_inserter(result));
-    std::copy(begin(r), end(r), std::back_inserter(result));
-    return result;
-}
+    template<typename It>
+    void add(It first, It last) {
+        append_lits(first, last);
+        end_clause();
+    }
+    void push_back(ClauseView c) { add(c.begin(), c.end()); }
+    void push_back(const Clause& c) { add(c.begin(), c.end()); }
+    void push_back(std::initializer_list<Lit> c) { add(c.begin(), c.end()); }
+
+    void append(const NormalForm& o) {
+        size_t base = lits.size();
+        lits.insert(lits.end(), o.lits.begin(), o.lits.end());
+        for(size_t i = 1; i < o.start.size(); i++)
+            start.push_back(base + o.start[i]);
+    }
+};
 
 NormalForm cross(const NormalForm& l, const NormalForm& r) {
     NormalForm result;
-    for(const auto& lc : l)
-        for(const auto& rc : r)
-            result.push_back(concat(lc, rc));
+    result.reserve(l.size() * r.size(), l.literals() * r.size() + r.literals() * l.size());
+    for(ClauseView lc : l)
+        for(ClauseView rc : r) {
+            result.append_lits(lc.begin(), lc.end());
+            result.append_lits(rc.begin(), rc.end());
+            result.end_clause();
+        }
     return result;
 }
 
-FormulaPtr distribute(const FormulaPtr& f) {
-    if(is<Binary>(f)) {
-        auto b = as<Binary>(f);
-        if(b.type == Binary::Or) {
-            if(is<Binary>(b.left) && as<Binary>(b.left).type == Binary::And) {
-                auto bl = as<Binary>(b.left);
-                return ptr(
-                    Binary{Binary::And,
-                    distribute(ptr(Binary{Binary::Or, bl.left, b.right})),
-                    distribute(ptr(Binary{Binary::Or, bl.right, b.right}))
-                });
-            }
-            if(is<Binary>(b.right) && as<Binary>(b.right).type == Binary::And) {
-                auto br = as<Binary>(b.right);
-                return ptr(
-                    Binary{Binary::And,
-                    distribute(ptr(Binary{Binary::Or, b.left, br.left})),
-                    distribute(ptr(Binary{Binary::Or, b.left, br.right}))
-                });
-            }
-        }
+// The passes below walk the DAG with an explicit stack instead of recursion,
+// so operator chains tens of thousands of nodes deep are fine, and memoize
+// their result per node id, so shared subformulas are transformed once.
+// A node stays on the stack until the results of its operands are known.
+struct Memo {
+    std::vector<uint32_t> result;
+
+    bool has(FormulaPtr f) const { return f.id < result.size() && result[f.id] != FormulaPtr::None; }
+    FormulaPtr operator[](FormulaPtr f) const { return FormulaPtr{result[f.id]}; }
 
-        return ptr(Binary{b.type, distribute(b.left), distribute(b.right)});
+    void set(FormulaPtr f, FormulaPtr r) {
+        if(f.id >= result.size())
+            result.resize(std::max<size_t>(f.id + 1, store().nodes.size()), FormulaPtr::None);
+        result[f.id] = r.id;
     }
-    if(is<Not>(f))
-        return ptr(Not{distribute(as<Not>(f).subformula)});
 
-    return f;
-}
+};
 
-FormulaPtr simplify(const FormulaPtr& f) {
+FormulaPtr simplify_node(const FormulaPtr& f, const Memo& memo) {
     if(is<False>(f) || is<True>(f) || is<Atom>(f))
         return f;
     if(is<Not>(f)) {
-        FormulaPtr s = simplify(as<Not>(f).subformula);
+        FormulaPtr s = memo[as<Not>(f).subformula];
         if(is<True>(s))
             return ptr(False{});
         if(is<False>(s))
@@ -76,8 +143,8 @@ FormulaPtr simplify(const FormulaPtr& f) {
         return ptr(Not{s});
     }
     auto b = as<Binary>(f);
-    FormulaPtr ls = simplify(b.left);
-    FormulaPtr rs = simplify(b.right);
+    FormulaPtr ls = memo[b.left];
+    FormulaPtr rs = memo[b.right];
     if(b.type == Binary::And) {
         if(is<False>(ls) || is<False>(rs))
             return ptr(False{});
@@ -118,119 +185,360 @@ FormulaPtr simplify(const FormulaPtr& f) {
             return ptr(Not{ls});
         return ptr(Binary{Binary::Eq, ls, rs});
     }
+    if(b.type == Binary::Xor) {
+        if(is<False>(ls))
+            return rs;
+        if(is<False>(rs))
+            return ls;
+        if(is<True>(ls) && is<True>(rs))
+            return ptr(False{});
+        if(is<True>(ls))
+            return ptr(Not{rs});
+        if(is<True>(rs))
+            return ptr(Not{ls});
+        return ptr(Binary{Binary::Xor, ls, rs});
+    }
+    if(b.type == Binary::Nand) {
+        if(is<False>(ls) || is<False>(rs))
+            return ptr(True{});
+        if(is<True>(ls) && is<True>(rs))
+            return ptr(False{});
+        if(is<True>(ls))
+            return ptr(Not{rs});
+        if(is<True>(rs))
+            return ptr(Not{ls});
+        return ptr(Binary{Binary::Nand, ls, rs});
+    }
+    if(b.type == Binary::Nor) {
+        if(is<True>(ls) || is<True>(rs))
+            return ptr(False{});
+        if(is<False>(ls) && is<False>(rs))
+            return ptr(True{});
+        if(is<False>(ls))
+            return ptr(Not{rs});
+        if(is<False>(rs))
+            return ptr(Not{ls});
+        return ptr(Binary{Binary::Nor, ls, rs});
+    }
     return FormulaPtr{};
 }
 
-FormulaPtr nnf(const FormulaPtr& f);
-
-FormulaPtr nnfNot(const FormulaPtr& f) {
-    if(is<True>(f))
-        return nnf(ptr(False{}));
-    if(is<False>(f))
-        return nnf(ptr(True{}));
-    if(is<Atom>(f))
-        return ptr(Not{f});
-    if(is<Not>(f))
-        return nnf(as<Not>(f).subformula);
-    auto b = as<Binary>(f);
-    if(b.type == Binary::And)
-        return ptr(Binary{Binary::Or, nnfNot(b.left), nnfNot(b.right)});
-    if(b.type == Binary::Or)
-        return ptr(Binary{Binary::And, nnfNot(b.left), nnfNot(b.right)});
-    if(b.type == Binary::Impl)
-        return ptr(Binary{Binary::And, nnf(b.left), nnfNot(b.right)});
-    if(b.type == Binary::Eq)
-        return ptr(Binary{
-            Binary::Or,
-            ptr(Binary{Binary::And, nnf(b.left), nnfNot(b.right)}),
-            ptr(Binary{Binary::And, nnfNot(b.left), nnf(b.right)})
-        });
-    return FormulaPtr{};
+// Every node of the cone is simplified once, operands first.
+FormulaPtr simplify(const FormulaPtr& f) {
+    Memo memo;
+    for(uint32_t id : cone({f}))
+        memo.set(FormulaPtr{id}, simplify_node(FormulaPtr{id}, memo));
+    return memo[f];
 }
 
-FormulaPtr nnf(const FormulaPtr& f) {
-   if(is<False>(f) || is<True>(f) || is<Atom>(f))
-       return f;
-   if(is<Not>(f))
-       return nnfNot(as<Not>(f).subformula);
-   auto b = as<Binary>(f);
-   if(b.type == Binary::And)
-       return ptr(Binary{Binary::And, nnf(b.left), nnf(b.right)});
-   if(b.type == Binary::Or)
-       return ptr(Binary{Binary::Or, nnf(b.left), nnf(b.right)});
-   if(b.type == Binary::Impl)
-       return ptr(Binary{Binary::Or, nnfNot(b.left), nnf(b.right)});
-   if(b.type == Binary::Eq)
-       return ptr(Binary{Binary::And,
-                         ptr(Binary{Binary::Or, nnfNot(b.left), nnf(b.right)}),
-                         ptr(Binary{Binary::Or, nnf(b.left), nnfNot(b.right)})
-                  });
-   return FormulaPtr{};
+// Negation normal form of f (negated: of ~f). Each node is needed in at most
+// two polarities, memoized separately.
+FormulaPtr nnf_polar(const FormulaPtr& f, bool negated) {
+    TRACE_SCOPE("nnf");
+    Memo memo[2];
+    std::vector<std::pair<FormulaPtr, bool>> stack = {{f, negated}};
+    // Pushes the (operand, polarity) pairs without a result yet.
+    auto ready = [&](std::initializer_list<std::pair<FormulaPtr, bool>> operands) {
+        bool all = true;
+        for(auto [o, neg] : operands)
+            if(!memo[neg].has(o)) {
+                stack.push_back({o, neg});
+                all = false;
+            }
+        return all;
+    };
+    while(!stack.empty()) {
+        auto [g, neg] = stack.back();
+        if(memo[neg].has(g)) {
+            stack.pop_back();
+            continue;
+        }
+        Memo& pos_of = memo[0];
+        Memo& neg_of = memo[1];
+        if(is<True>(g) || is<False>(g))
+            memo[neg].set(g, neg ? ptr(is<True>(g) ? Formula{False{}} : Formula{True{}}) : g);
+        else if(is<Atom>(g))
+            memo[neg].set(g, neg ? ptr(Not{g}) : g);
+        else if(is<Not>(g)) {
+            FormulaPtr sub = as<Not>(g).subformula;
+            if(ready({{sub, !neg}}))
+                memo[neg].set(g, memo[!neg][sub]);
+        }
+        else {
+            auto b = as<Binary>(g);
+            FormulaPtr l = b.left, r = b.right;
+            switch(b.type) {
+                case Binary::And:
+                case Binary::Or:
+                    if(ready({{l, neg}, {r, neg}})) {
+                        bool conj = (b.type == Binary::And) != neg;
+                        memo[neg].set(g, ptr(Binary{conj ? Binary::And : Binary::Or, memo[neg][l], memo[neg][r]}));
+                    }
+                    break;
+                case Binary::Nand:
+                case Binary::Nor:
+                    if(ready({{l, !neg}, {r, !neg}})) {
+                        bool conj = (b.type == Binary::Nor) != neg;
+                        memo[neg].set(g, ptr(Binary{conj ? Binary::And : Binary::Or, memo[!neg][l], memo[!neg][r]}));
+                    }
+                    break;
+                case Binary::Impl:
+                    if(ready({{l, !neg}, {r, neg}}))
+                        memo[neg].set(g, neg ? ptr(Binary{Binary::And, pos_of[l], neg_of[r]})
+                                             : ptr(Binary{Binary::Or, neg_of[l], pos_of[r]}));
+                    break;
+                case Binary::Eq:
+                case Binary::Xor:
+                    if(ready({{l, false}, {l, true}, {r, false}, {r, true}}))
+                        memo[neg].set(g, neg != (b.type == Binary::Xor) ? ptr(Binary{Binary::Or,
+                                                          ptr(Binary{Binary::And, pos_of[l], neg_of[r]}),
+                                                          ptr(Binary{Binary::And, neg_of[l], pos_of[r]})})
+                                             : ptr(Binary{Binary::And,
+                                                          ptr(Binary{Binary::Or, neg_of[l], pos_of[r]}),
+                                                          ptr(Binary{Binary::Or, pos_of[l], neg_of[r]})}));
+                    break;
+            }
+        }
+    }
+    return memo[negated][f];
 }
 
-NormalForm cnf_rec(const FormulaPtr& f) {
-    if(is<True>(f))
-        return {};
-    if(is<False>(f))
-        return {{}};
-    if(is<Atom>(f))
-        return {{Literal{true, as<Atom>(f).name}}};
-    if(is<Not>(f))
-        return {{Literal{false, as<Atom>(as<Not>(f).subformula).name}}};
-    auto b = as<Binary>(f);
-    if(b.type == Binary::And)
-        return concat(cnf_rec(b.left), cnf_rec(b.right));
-    if(b.type == Binary::Or)
-        return cross(cnf_rec(b.left), cnf_rec(b.right));
-    return NormalForm{};
-}
+FormulaPtr nnf(const FormulaPtr& f) { return nnf_polar(f, false); }
 
-NormalForm cnf_clean(const NormalForm& cnf) {
-    NormalForm cnf_cleaned;
+FormulaPtr nnfNot(const FormulaPtr& f) { return nnf_polar(f, true); }
 
-    std::set<Clause> clauses;
-    for(auto &c : cnf) {
-        std::set<std::pair<std::string, bool>> literals;
-        bool taut = false;
+// Default bound on the clauses a single distributed subtree may expand to.
+constexpr size_t DistributeBudget = size_t(1) << 16;
 
-        for(auto &l : c) {
-            auto neg = std::make_pair(l.name, !l.pos);
-            if(literals.count(neg)) {
-                taut = true;
-                break;
-            }
-            literals.insert({l.name, l.pos});
-        }
+// Which Or nodes of the NNF were expanded by distribution and which operands
+// were replaced by an auxiliary variable instead.
+struct DistributeReport {
+    size_t expanded = 0, encoded = 0;
+    std::vector<FormulaPtr> encoded_subtrees;
+};
 
-        if(taut)
+// CNF of an NNF formula by concatenation (And) and cross product (Or) of the
+// operand CNFs, bottom-up over the cone. Clause counts are predicted first;
+// when an Or would exceed `budget` clauses its larger operand (both, if
+// needed) is replaced by a fresh auxiliary x, defined by ~x | C for every
+// clause C of the operand. NNF is monotone, so this one direction suffices.
+// Results are memoized per node; an operand used by a single parent is moved
+// into it, and every result is released once its last parent consumed it.
+NormalForm distribute(const FormulaPtr& f, size_t budget = DistributeBudget, DistributeReport* report = nullptr) {
+    TRACE_SCOPE("distribute");
+    budget = std::max<size_t>(budget, 1);
+    std::vector<uint32_t> order = cone({f});
+    std::vector<uint32_t> uses(store().nodes.size(), 0);
+    std::vector<size_t> count(store().nodes.size(), 1);
+    std::vector<bool> encoded(store().nodes.size(), false);
+    auto product = [](size_t a, size_t b) { return b && a > SIZE_MAX / b ? SIZE_MAX : a * b; };
+    for(uint32_t id : order) {
+        FormulaPtr g{id};
+        if(is<True>(g))
+            count[id] = 0;
+        if(!is<Binary>(g))
+            continue;
+        auto b = as<Binary>(g);
+        uses[b.left.id]++;
+        uses[b.right.id]++;
+        size_t& l = count[b.left.id];
+        size_t& r = count[b.right.id];
+        if(b.type == Binary::And) {
+            count[id] = l > SIZE_MAX - r ? SIZE_MAX : l + r;
             continue;
+        }
+        for(int k = 0; k < 2 && product(l, r) > budget; k++) {
+            uint32_t big = l >= r ? b.left.id : b.right.id;
+            encoded[big] = true;
+            count[big] = 1;
+            if(report) {
+                report->encoded++;
+                report->encoded_subtrees.push_back(FormulaPtr{big});
+            }
+        }
+        count[id] = product(l, r);
+        if(report && l > 1 && r > 1)
+            report->expanded++;
+    }
 
-        Clause new_clause;
-        for(auto& [name, pos] : literals)
-            new_clause.push_back({pos, name});
-        clauses.insert(new_clause);
+    NormalForm out;
+    std::unordered_map<uint32_t, NormalForm> results;
+    auto take = [&](FormulaPtr g) {
+        auto it = results.find(g.id);
+        if(--uses[g.id] > 0)
+            return it->second;
+        NormalForm r = std::move(it->second);
+        results.erase(it);
+        return r;
+    };
+    for(uint32_t id : order) {
+        FormulaPtr g{id};
+        NormalForm r;
+        if(is<False>(g))
+            r.push_back({});
+        else if(is<Atom>(g))
+            r.push_back({make_lit(as<Atom>(g).var, false)});
+        else if(is<Not>(g))
+            r.push_back({make_lit(as<Atom>(as<Not>(g).subformula).var, true)});
+        else if(is<Binary>(g)) {
+            auto b = as<Binary>(g);
+            NormalForm l = take(b.left), rr = take(b.right);
+            if(b.type == Binary::And) {
+                r = std::move(l);
+                r.append(rr);
+            }
+            else if(b.type == Binary::Or)
+                r = cross(l, rr);
+        }
+        if(encoded[id]) {
+            Lit x = make_lit(vars().fresh(), false);
+            for(ClauseView clause : r) {
+                out.append_lits(clause.begin(), clause.end());
+                out.append_lit(lit_not(x));
+                out.end_clause();
+            }
+            r.clear();
+            r.push_back({x});
+        }
+        results[id] = std::move(r);
     }
+    out.append(results[f.id]);
+    TRACE_COUNT(ClausesProduced, out.size());
+    return out;
+}
 
-    for(Clause clause : clauses)
-        cnf_cleaned.push_back(clause);
+// Removes tautologies, duplicate literals and duplicate clauses, keeping
+// first occurrences in input order; the clauses are compacted in place, so
+// pass a temporary to avoid a copy. Literals are not sorted: a first pass (in
+// parallel chunks on up to `threads` threads, 0 for all cores, for large
+// inputs) stamps each clause's literals into a per-variable mark array to
+// find repeats and tautologies and sums an order-independent hash; a second
+// pass drops duplicates through an open-addressing table.
+NormalForm cnf_clean(NormalForm cnf, size_t threads = 0) {
+    TRACE_SCOPE("cnf_clean");
+    constexpr size_t Tautology = SIZE_MAX;
+    size_t n = cnf.size();
+    std::vector<size_t> start = std::move(cnf.start);
+    std::vector<Lit>& lits = cnf.lits;
+    std::vector<size_t> length(n);
+    std::vector<uint64_t> hash(n);
+    // vars() is thread-local, so it is sized here for the workers.
+    size_t n_lits = 2 * vars().size() + 2;
 
-    return cnf_cleaned;
+    auto lit_hash = [](Lit l) {
+        uint64_t z = (uint64_t(l) + 1) * 0x9E3779B97F4A7C15ull;
+        return z ^ (z >> 31);
+    };
+    auto normalize = [&](size_t first, size_t last) {
+        std::vector<uint32_t> mark(n_lits, 0);
+        uint32_t stamp = 0;
+        for(size_t i = first; i < last; i++) {
+            stamp++;
+            size_t k = 0;
+            uint64_t h = 0;
+            for(size_t j = start[i]; j < start[i + 1]; j++) {
+                Lit l = lits[j];
+                if(mark[l] == stamp)
+                    continue;
+                if(mark[lit_not(l)] == stamp) {
+                    k = Tautology;
+                    break;
+                }
+                mark[l] = stamp;
+                k++;
+                h += lit_hash(l);
+            }
+            length[i] = k;
+            hash[i] = h ^ (h >> 29);
+        }
+    };
+    if(threads == 0)
+        threads = std::thread::hardware_concurrency();
+    threads = std::min<size_t>(threads, n / 8192);
+    if(threads <= 1)
+        normalize(0, n);
+    else {
+        std::vector<std::thread> workers;
+        for(size_t t = 0; t < threads; t++)
+            workers.emplace_back(normalize, n * t / threads, n * (t + 1) / threads);
+        for(auto& w : workers)
+            w.join();
+    }
+
+    // Kept clause c is written over the input from cnf.start[c] on, and its
+    // hash and length move to index c. The table holds kept clause numbers
+    // (c + 1, 0 for an empty slot) with linear probing; input clause i equals
+    // kept clause c if both have as many distinct literals and every literal
+    // of i is marked by c.
+    size_t mask = 15;
+    while(mask < 2 * n)
+        mask = 2 * mask + 1;
+    std::vector<uint32_t> table(mask + 1, 0);
+    std::vector<uint32_t> mark(n_lits, 0);
+    uint32_t stamp = 0;
+    auto same = [&](size_t c, size_t i) {
+        if(hash[c] != hash[i] || length[c] != length[i])
+            return false;
+        stamp++;
+        for(size_t k = cnf.start[c]; k < cnf.start[c + 1]; k++)
+            mark[lits[k]] = stamp;
+        for(size_t k = start[i]; k < start[i + 1]; k++)
+            if(mark[lits[k]] != stamp)
+                return false;
+        return true;
+    };
+    cnf.start.assign(1, 0);
+    size_t w = 0;
+    for(size_t i = 0; i < n; i++) {
+        if(length[i] == Tautology)
+            continue;
+        size_t p = hash[i] & mask;
+        while(table[p] && !same(table[p] - 1, i))
+            p = (p + 1) & mask;
+        if(table[p])
+            continue;
+        size_t c = cnf.size();
+        table[p] = uint32_t(c + 1);
+        hash[c] = hash[i];
+        length[c] = length[i];
+        if(length[i] == start[i + 1] - start[i]) {
+            if(w != start[i])
+                std::memmove(lits.data() + w, lits.data() + start[i], length[i] * sizeof(Lit));
+            w += length[i];
+        }
+        else {
+            stamp++;
+            for(size_t k = start[i]; k < start[i + 1]; k++)
+                if(mark[lits[k]] != stamp) {
+                    mark[lits[k]] = stamp;
+                    lits[w++] = lits[k];
+                }
+        }
+        cnf.start.push_back(w);
+    }
+    lits.resize(w);
+    TRACE_COUNT(ClausesCleaned, n - cnf.size());
+    return cnf;
 }
 
-NormalForm cnf(const FormulaPtr& f) {
+// `threads` is passed on to cnf_clean.
+NormalForm cnf(const FormulaPtr& f, size_t budget = DistributeBudget, DistributeReport* report = nullptr,
+               size_t threads = 0) {
+    TRACE_SCOPE("cnf");
     FormulaPtr f_nnf = nnf(f);
-    FormulaPtr f_nnf_dist = distribute(f_nnf);
-    NormalForm f_cnf = cnf_rec(f_nnf_dist);
-    NormalForm f_cnf_clean = cnf_clean(f_cnf);
+    NormalForm f_cnf = distribute(f_nnf, budget, report);
+    NormalForm f_cnf_clean = cnf_clean(std::move(f_cnf), threads);
     return f_cnf_clean;
 }
 
 void print(const NormalForm& f) {
-    for(const auto& clause : f) {
+    for(ClauseView clause : f) {
         std::cout << "[ ";
-        for (const auto &literal : clause)
-            std::cout << (literal.pos ? "" : "~") << literal.name << " ";
+        for (Lit literal : clause)
+            std::cout << (lit_neg(literal) ? "~" : "") << vars().name(lit_var(literal)) << " ";
         std::cout << "]";
     }
     std::cout << std::endl;
-}
\ No newline at end of file
+}
+
+#endif
\ No newline at end of file
@@ -1,8 +1,31 @@
 #include "formula.hpp"
 
+#include <cstring>
+
+// Binary operators from loosest to tightest binding. `->` groups to the
+// right, all others to the left. Longer tokens come first so `<->` is not
+// read as `<` and `~&` / `~|` are not read as a negation.
+struct BinaryOperator {
+    const char* token;
+    Binary::Type type;
+    int precedence;
+    bool right_assoc;
+};
+
+const BinaryOperator binary_operators[] = {
+    {"<->", Binary::Eq,   1, false},
+    {"->",  Binary::Impl, 2, true},
+    {"~|",  Binary::Nor,  3, false},
+    {"|",   Binary::Or,   3, false},
+    {"^",   Binary::Xor,  4, false},
+    {"~&",  Binary::Nand, 5, false},
+    {"&",   Binary::And,  5, false},
+};
+
 struct Parser {
     std::string s;
-    int pos = 0;
+    size_t pos = 0;
+    bool failed = false;
 
     explicit Parser(std::string str) : s(std::move(str)) {}
 
@@ -21,62 +44,84 @@ struct Parser {
         return false;
     }
 
+    static bool name_start(char c) { return isalpha(c) || c == '_'; }
+    static bool name_char(char c) { return isalnum(c) || c == '_'; }
+
+    // Atoms are a letter or underscore followed by letters, digits and
+    // underscores; the names T and F are the constants.
     FormulaPtr parse_atom() {
         skip();
-        
-        if(s[pos] == '(') {
-            pos++;
-            auto f = parse_or();
-            skip();
-            pos++;
+
+        if(match('(')) {
+            auto f = parse_binary(1);
+            if(!match(')'))
+                failed = true;
 
             return f;
         }
 
-        if(isalpha(s[pos])) {
+        if(pos < s.size() && name_start(s[pos])) {
             std::string name;
-            while(pos < s.size() && isalpha(s[pos])) {
+            while(pos < s.size() && name_char(s[pos])) {
                 name += s[pos];
                 pos++;
             }
 
+            if(name == "T")
+                return ptr(True{});
+            if(name == "F")
+                return ptr(False{});
             return ptr(Atom{name});
         }
 
+        failed = true;
         return FormulaPtr{};
     }
 
-    FormulaPtr parse_string_into_formula() {
-        return parse_or();
+    FormulaPtr parse_not() {
+        int negations = 0;
+        while(match('~'))
+            negations++;
+        auto f = parse_atom();
+        while(!failed && negations--)
+            f = ptr(Not{f});
+        return f;
     }
 
-    FormulaPtr parse_not() {
-        if(match('~'))
-            return ptr(as<Not>(parse_not()));
-        return parse_atom();
+    // The binary operator at pos, or nullptr.
+    const BinaryOperator* peek_operator() {
+        skip();
+        for(const BinaryOperator& op : binary_operators)
+            if(s.compare(pos, strlen(op.token), op.token) == 0)
+                return &op;
+        return nullptr;
     }
 
-    FormulaPtr parse_and() {
+    // Precedence climbing: parses operands joined by operators that bind at
+    // least as tightly as min_precedence.
+    FormulaPtr parse_binary(int min_precedence) {
         auto left = parse_not();
-        skip();
-        while(match('&')) {
-            auto right = parse_not();
-            left = ptr(Binary{Binary::And, left, right});
-            skip();
+        while(!failed) {
+            const BinaryOperator* op = peek_operator();
+            if(!op || op->precedence < min_precedence)
+                break;
+            pos += strlen(op->token);
+            auto right = parse_binary(op->right_assoc ? op->precedence : op->precedence + 1);
+            if(failed)
+                break;
+            left = ptr(Binary{op->type, left, right});
         }
 
         return left;
     }
 
-    FormulaPtr parse_or() {
-        auto left = parse_and();
+    // Returns an empty FormulaPtr if the whole string is not a formula.
+    FormulaPtr parse_string_into_formula() {
+        TRACE_SCOPE("parse");
+        auto f = parse_binary(1);
         skip();
-        while(match('|')) {
-            auto right = parse_and();
-            left = ptr(Binary{Binary::Or, left, right});
-            skip();
-        }
-
-        return left;
+        if(failed || pos < s.size())
+            return FormulaPtr{};
+        return f;
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,442 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "parsing.hpp"
+#include "bdd.hpp"
+#include "fraig.hpp"
+#include "preprocess.hpp"
+#include "truthtable.hpp"
+#include "portfolio.hpp"
+#include "threadpool.hpp"
+#include "json.hpp"
+
+#include <chrono>
+#include <map>
+
+using json = nlohmann::json;
+
+enum class Engine { Cnf, Aig, Bdd };
+
+struct CheckOptions {
+    Engine engine = Engine::Aig;
+    CnfEncoding encoding = CnfEncoding::PlaistedGreenbaum;
+    size_t jobs = 1;
+    // Threads one pair's CNF cleaning and truth tables may use; 0 means all
+    // cores, and run_batch uses 1 on its thread pool.
+    size_t threads = 0;
+    size_t portfolio = 1;
+    bool share = false;
+    bool fraig = true;
+    size_t distribute_budget = DistributeBudget;
+    bool preprocess = true;
+    PreprocessOptions preprocessing;
+    // The BDD engine gives up on a pair past this many nodes or this much
+    // work (apply steps and reordering swaps) and falls back to the AIG one.
+    size_t bdd_node_limit = size_t(1) << 20;
+    size_t bdd_work_limit = size_t(1) << 22;
+    // Random patterns simulated before any engine runs; 0 disables.
+    size_t sim_patterns = 4096;
+    // Pairs over at most this many atoms are decided by their full truth
+    // tables, unless that takes more than exhaustive_work word operations.
+    size_t exhaustive_inputs = 22;
+    size_t exhaustive_work = size_t(1) << 31;
+};
+
+// Outcome of one parse -> miter -> CNF -> solve run on a formula pair.
+struct PairResult {
+    size_t index = 0;
+    std::string verdict;
+    std::string decided_by;
+    std::string error;
+    Valuation counterexample;
+
+    double parse_ms = 0, sim_ms = 0, cnf_ms = 0, preprocess_ms = 0, solve_ms = 0, total_ms = 0;
+    size_t nodes = 0, vars = 0, clauses = 0, simplified_clauses = 0;
+    DistributeReport distribution;
+
+    json to_json() const {
+        json r = {
+            {"index", index},
+            {"verdict", verdict},
+            {"decided_by", decided_by},
+            {"timings_ms", {{"parse", parse_ms}, {"simulate", sim_ms}, {"cnf", cnf_ms}, {"preprocess", preprocess_ms}, {"solve", solve_ms}, {"total", total_ms}}},
+            {"sizes", {{"nodes", nodes}, {"vars", vars}, {"clauses", clauses}, {"simplified_clauses", simplified_clauses}}}
+        };
+        if(distribution.expanded || distribution.encoded)
+            r["distribution"] = {{"expanded", distribution.expanded}, {"encoded", distribution.encoded}};
+        if(!error.empty())
+            r["error"] = error;
+        if(verdict == "not_equivalent")
+            r["counterexample"] = counterexample;
+        return r;
+    }
+};
+
+struct Stopwatch {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    double lap() {
+        auto now = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - start).count();
+        start = now;
+        return ms;
+    }
+};
+
+// Preprocesses (if enabled) and solves a miter CNF, setting the verdict and
+// a counterexample over the atoms of the miter.
+void solve_miter(PairResult& r, const EncodedCnf& miter, const CheckOptions& options, Stopwatch& stage) {
+    Preprocessor pre(options.preprocessing);
+    NormalForm simplified;
+    if(options.preprocess)
+        simplified = pre.run(miter.cnf);
+    const NormalForm& cnf = options.preprocess ? simplified : miter.cnf;
+    r.simplified_clauses = cnf.size();
+    r.preprocess_ms = stage.lap();
+
+    SatAnswer answer = solve_portfolio(cnf, options.portfolio, options.share);
+    if(answer.result == SatResult::Unsat)
+        r.verdict = "equivalent";
+    else if(answer.result == SatResult::Sat) {
+        r.verdict = "not_equivalent";
+        if(options.preprocess)
+            pre.extend(answer.model);
+        r.counterexample = miter.project(answer.model);
+    }
+    else
+        r.verdict = "unknown";
+    r.solve_ms = stage.lap();
+}
+
+// True if f == g is small enough to decide from the full truth table.
+// exhaustive_inputs == 0 turns the stage off, even for constant pairs.
+bool use_truth_table(const FormulaPtr& f, const FormulaPtr& g, const CheckOptions& options) {
+    if(options.exhaustive_inputs == 0)
+        return false;
+    AtomSet atoms;
+    getAtoms(f, atoms);
+    getAtoms(g, atoms);
+    if(atoms.size() > options.exhaustive_inputs || atoms.size() >= 64)
+        return false;
+    size_t words = std::max<size_t>(1, (size_t(1) << atoms.size()) / 64);
+    return cone({f, g}).size() <= options.exhaustive_work / words;
+}
+
+// Decides f == g by comparing the BDDs of f and g. Returns false, leaving r
+// untouched, if the BDDs outgrow options.bdd_node_limit or take more than
+// options.bdd_work_limit work.
+bool check_bdd(const FormulaPtr& f, const FormulaPtr& g, const CheckOptions& options, PairResult& r) {
+    TRACE_SCOPE("bdd");
+    Bdd bdd;
+    bdd.node_limit = options.bdd_node_limit;
+    bdd.work_limit = options.bdd_work_limit;
+    BddEdge bf = bdd.from_formula(f);
+    BddEdge bg = bdd.overflow ? Bdd::False : bdd.from_formula(g);
+    BddEdge diff = bdd.overflow || bf == bg ? Bdd::False : bdd.apply_xor(bf, bg);
+    if(bdd.overflow)
+        return false;
+    r.decided_by = "bdd";
+    r.nodes = bdd.live();
+    if(bf == bg) {
+        r.verdict = "equivalent";
+        return true;
+    }
+    r.verdict = "not_equivalent";
+    AtomSet atoms;
+    getAtoms(f, atoms);
+    getAtoms(g, atoms);
+    for(const auto& atom : atoms)
+        r.counterexample[atom] = false;
+    for(auto [v, value] : bdd.satisfying_path(diff))
+        r.counterexample[vars().name(v)] = value;
+    return true;
+}
+
+// Decides f == g on already parsed formulas, filling verdict, stage timings
+// and sizes of r. Random simulation runs first and settles most
+// non-equivalent pairs, then pairs with few atoms are decided by truth
+// tables; the BDD engine falls back to the AIG one past its node or work limit.
+void check_formulas(const FormulaPtr& f, const FormulaPtr& g, const CheckOptions& options, PairResult& r) {
+    Stopwatch stage;
+
+    if(options.sim_patterns) {
+        TRACE_SCOPE("simulate");
+        bool differ = find_difference(f, g, options.sim_patterns, r.counterexample);
+        r.sim_ms = stage.lap();
+        if(differ) {
+            r.decided_by = "simulation";
+            r.verdict = "not_equivalent";
+            return;
+        }
+    }
+
+    if(use_truth_table(f, g, options)) {
+        TRACE_SCOPE("truth_table");
+        r.decided_by = "truth_table";
+        r.verdict = exhaustive_difference(f, g, r.counterexample, options.threads) ? "not_equivalent" : "equivalent";
+        r.solve_ms = stage.lap();
+        return;
+    }
+
+    if(options.engine == Engine::Bdd && check_bdd(f, g, options, r)) {
+        r.solve_ms = stage.lap();
+        return;
+    }
+
+    if(options.engine != Engine::Cnf) {
+        Aig aig;
+        AigLit lf = aig.from_formula(f), lg = aig.from_formula(g);
+        AigLit miter = aig.make_xor(lf, lg);
+        r.nodes = aig.size();
+        if(miter == Aig::False || miter == Aig::True) {
+            r.decided_by = "structural";
+            r.verdict = miter == Aig::False ? "equivalent" : "not_equivalent";
+            if(miter == Aig::True) {
+                AtomSet atoms;
+                getAtoms(f, atoms);
+                getAtoms(g, atoms);
+                for(const auto& atom : atoms)
+                    r.counterexample[atom] = false;
+            }
+            r.cnf_ms = stage.lap();
+            return;
+        }
+        Fraig fraig(aig);
+        if(options.fraig) {
+            fraig.run({lf, lg});
+            miter = fraig.out.make_xor(fraig.lit(lf), fraig.lit(lg));
+            if(miter == Aig::False) {
+                r.decided_by = "fraig";
+                r.verdict = "equivalent";
+                r.cnf_ms = stage.lap();
+                return;
+            }
+        }
+        EncodedCnf miter_cnf = options.fraig ? fraig.out.to_cnf(miter) : aig.to_cnf(miter);
+        r.cnf_ms = stage.lap();
+        r.vars = vars().size();
+        r.clauses = miter_cnf.cnf.size();
+
+        r.decided_by = "sat";
+        solve_miter(r, miter_cnf, options, stage);
+        return;
+    }
+
+    FormulaPtr miter = make_miter(f, g);
+    EncodedCnf miter_cnf = encode(miter, options.encoding, options.distribute_budget, &r.distribution, options.threads);
+    r.cnf_ms = stage.lap();
+    r.nodes = store().nodes.size();
+    r.vars = vars().size();
+    r.clauses = miter_cnf.cnf.size();
+
+    r.decided_by = "sat";
+    solve_miter(r, miter_cnf, options, stage);
+}
+
+// Checks f_i == g_i for every output of a multi-output circuit. With the AIG
+// engine all outputs share one AIG and one incremental solver: the AIG is
+// encoded once, every output miter is guarded by an activation literal and
+// solved under that assumption, so shared logic and learnt clauses are reused
+// from one output to the next. The CNF engine checks outputs one by one.
+std::vector<PairResult> check_outputs(const std::vector<std::pair<FormulaPtr, FormulaPtr>>& outputs, const CheckOptions& options) {
+    std::vector<PairResult> results(outputs.size());
+    if(options.engine != Engine::Aig) {
+        for(size_t i = 0; i < outputs.size(); i++) {
+            results[i].index = i;
+            check_formulas(outputs[i].first, outputs[i].second, options, results[i]);
+        }
+        return results;
+    }
+
+    // Outputs that simulation tells apart or that are small enough for truth
+    // tables are settled before any encoding.
+    Stopwatch stage;
+    std::vector<bool> settled(outputs.size(), false);
+    for(size_t i = 0; i < outputs.size(); i++) {
+        PairResult& r = results[i];
+        const auto& [f, g] = outputs[i];
+        if(options.sim_patterns) {
+            TRACE_SCOPE("simulate", int64_t(i));
+            if(find_difference(f, g, options.sim_patterns, r.counterexample)) {
+                settled[i] = true;
+                r.decided_by = "simulation";
+                r.verdict = "not_equivalent";
+            }
+            r.sim_ms = stage.lap();
+        }
+        if(!settled[i] && use_truth_table(f, g, options)) {
+            TRACE_SCOPE("truth_table", int64_t(i));
+            settled[i] = true;
+            r.decided_by = "truth_table";
+            r.verdict = exhaustive_difference(f, g, r.counterexample, options.threads) ? "not_equivalent" : "equivalent";
+            r.solve_ms = stage.lap();
+        }
+    }
+
+    Aig aig;
+    std::vector<AigLit> miters, open;
+    for(size_t i = 0; i < outputs.size(); i++) {
+        miters.push_back(aig.make_xor(aig.from_formula(outputs[i].first), aig.from_formula(outputs[i].second)));
+        if(!settled[i])
+            open.push_back(miters[i]);
+    }
+    NormalForm cnf;
+    aig.define_cone(open, cnf);
+    Solver s;
+    while(s.num_vars() < aig.size())
+        s.new_var();
+    for(ClauseView clause : cnf)
+        s.add_clause(Clause(clause.begin(), clause.end()));
+    double cnf_ms = stage.lap();
+
+    for(size_t i = 0; i < outputs.size(); i++) {
+        PairResult& r = results[i];
+        r.index = i;
+        r.nodes = aig.size();
+        r.clauses = cnf.size();
+        r.cnf_ms = i == 0 ? cnf_ms : 0;
+        if(settled[i]) {
+            r.total_ms = r.cnf_ms + r.sim_ms + r.solve_ms;
+            continue;
+        }
+        AtomSet atoms;
+        getAtoms(outputs[i].first, atoms);
+        getAtoms(outputs[i].second, atoms);
+
+        SatResult result;
+        if(miters[i] == Aig::False || miters[i] == Aig::True) {
+            r.decided_by = "structural";
+            result = miters[i] == Aig::False ? SatResult::Unsat : SatResult::Sat;
+        }
+        else {
+            r.decided_by = "sat";
+            Lit act = make_lit(s.new_var(), false);
+            s.add_clause({lit_not(act), miters[i]});
+            TRACE_SCOPE("solve", int64_t(i));
+            result = s.solve({act});
+            s.add_clause({lit_not(act)});
+        }
+        r.vars = s.num_vars();
+
+        if(result == SatResult::Unsat)
+            r.verdict = "equivalent";
+        else if(result == SatResult::Sat) {
+            r.verdict = "not_equivalent";
+            for(const auto& atom : atoms) {
+                auto it = aig.inputs.find(vars().intern(atom));
+                r.counterexample[atom] = r.decided_by == "sat" && it != aig.inputs.end() && s.model_value(it->second);
+            }
+        }
+        else
+            r.verdict = "unknown";
+        r.solve_ms = stage.lap();
+        r.total_ms = r.cnf_ms + r.sim_ms + r.solve_ms;
+    }
+    return results;
+}
+
+// Checks f == g. Uses (and clears) the calling thread's formula store.
+PairResult check_pair(const std::string& f_string, const std::string& g_string, const CheckOptions& options) {
+    PairResult r;
+    Stopwatch total, stage;
+    store().clear();
+
+    Parser p_f(f_string);
+    FormulaPtr f = p_f.parse_string_into_formula();
+    Parser p_g(g_string);
+    FormulaPtr g = p_g.parse_string_into_formula();
+    r.parse_ms = stage.lap();
+    if(!f || !g) {
+        r.verdict = "error";
+        r.error = !f ? "cannot parse f" : "cannot parse g";
+        r.total_ms = total.lap();
+        return r;
+    }
+
+    check_formulas(f, g, options, r);
+    r.total_ms = total.lap();
+    return r;
+}
+
+// Splits a batch line "f ; g". Empty lines and lines starting with '#' are skipped.
+bool split_pair(const std::string& line, std::string& f, std::string& g) {
+    size_t start = line.find_first_not_of(" \t\r");
+    if(start == std::string::npos || line[start] == '#')
+        return false;
+    size_t sep = line.find(';');
+    f = line.substr(0, sep);
+    g = sep == std::string::npos ? "" : line.substr(sep + 1);
+    return true;
+}
+
+// Streams pairs from `in` and writes one JSON result per line to `out`, in
+// input order. With options.jobs > 1 pairs are checked on a thread pool with
+// at most a few pairs per worker in flight, so memory stays bounded by the
+// largest pairs rather than the batch size. Returns the pair count.
+size_t run_batch(std::istream& in, std::ostream& out, const CheckOptions& options) {
+    std::string line, f, g;
+    size_t submitted = 0;
+
+    if(options.jobs <= 1) {
+        while(std::getline(in, line)) {
+            if(!split_pair(line, f, g))
+                continue;
+            TRACE_SCOPE("pair", int64_t(submitted));
+            PairResult r = check_pair(f, g, options);
+            r.index = submitted++;
+            out << r.to_json().dump() << '\n';
+        }
+        out.flush();
+        return submitted;
+    }
+
+    ThreadPool pool(options.jobs);
+    CheckOptions pair_options = options;
+    if(pair_options.threads == 0)
+        pair_options.threads = 1;
+    std::mutex m;
+    std::condition_variable done_cv;
+    std::map<size_t, std::string> done;
+    size_t written = 0;
+    size_t window = 4 * pool.size();
+
+    auto drain = [&](std::unique_lock<std::mutex>& lock, size_t limit) {
+        for(;;) {
+            done_cv.wait(lock, [&] { return submitted - written < limit || done.count(written); });
+            while(done.count(written)) {
+                out << done[written] << '\n';
+                done.erase(written++);
+            }
+            if(submitted - written < limit)
+                return;
+        }
+    };
+
+    while(std::getline(in, line)) {
+        if(!split_pair(line, f, g))
+            continue;
+        {
+            std::unique_lock<std::mutex> lock(m);
+            drain(lock, window);
+        }
+        size_t index = submitted++;
+        pool.submit([&, index, f, g] {
+            TRACE_SCOPE("pair", int64_t(index));
+            PairResult r = check_pair(f, g, pair_options);
+            r.index = index;
+            std::string result = r.to_json().dump();
+            std::lock_guard<std::mutex> lock(m);
+            done.emplace(index, std::move(result));
+            done_cv.notify_one();
+        });
+    }
+    {
+        std::unique_lock<std::mutex> lock(m);
+        drain(lock, 1);
+    }
+    pool.wait();
+    out.flush();
+    return submitted;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef PORTFOLIO_H
+#define PORTFOLIO_H
+
+#include "solver.hpp"
+
+#include <thread>
+
+// Configuration of the i-th portfolio member: member 0 is the default
+// solver, the others vary restarts, initial phase, seed and random decisions.
+SolverOptions portfolio_member(size_t i) {
+    SolverOptions o;
+    o.seed = i;
+    o.restarts = i % 2 ? SolverOptions::Geometric : SolverOptions::Luby;
+    o.phase = SolverOptions::Phase(i % 3);
+    o.random_freq = i >= 3 ? 0.01 * double(i % 4) : 0;
+    return o;
+}
+
+// Runs `members` differently configured solvers on the same CNF in parallel
+// and returns the first answer, stopping the rest. With `share` set members
+// exchange learnt clauses of LBD <= 2 at restarts.
+SatAnswer solve_portfolio(const NormalForm& cnf, size_t members, bool share) {
+    TRACE_SCOPE("solve");
+    if(members <= 1)
+        return solve(cnf);
+
+    std::atomic<bool> stop{false};
+    std::mutex m;
+    SatAnswer answer;
+    ClauseExchange exchange;
+
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < members; i++)
+        threads.emplace_back([&, i] {
+            Solver s(portfolio_member(i));
+            s.stop = &stop;
+            if(share) {
+                s.exchange = &exchange;
+                s.exchange_id = i;
+            }
+            load(s, cnf);
+            SatResult result = s.solve();
+            if(result == SatResult::Unknown)
+                return;
+            std::lock_guard<std::mutex> lock(m);
+            if(!stop.exchange(true))
+                answer = answer_of(s, result, cnf);
+        });
+    for(auto& t : threads)
+        t.join();
+    return answer;
+}
+
+#endif
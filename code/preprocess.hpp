@@ -0,0 +1,313 @@
+#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+#include "normalform.hpp"
+
+#include <chrono>
+
+struct PreprocessOptions {
+    double subsume_ms = 100, eliminate_ms = 100;
+    size_t occurrence_limit = 16;
+    size_t resolvent_limit = 24;
+};
+
+// CNF simplification before solving: unit propagation, backward subsumption,
+// self-subsuming strengthening and bounded variable elimination over
+// occurrence lists, with a time budget per technique. The result is
+// equisatisfiable with the input; extend() turns a model of the result into
+// a model of the input.
+struct Preprocessor {
+    using Clock = std::chrono::steady_clock;
+
+    PreprocessOptions options;
+    std::vector<Clause> clauses;
+    std::vector<bool> removed;
+    std::vector<std::vector<uint32_t>> occurs;
+    std::vector<int8_t> value;
+    std::vector<bool> present, eliminated;
+    std::vector<std::pair<Lit, Clause>> elim_stack;
+    std::vector<Lit> units;
+    std::vector<uint8_t> mark;
+    bool unsat = false;
+
+    size_t subsumed = 0, strengthened = 0, eliminated_vars = 0, fixed = 0;
+
+    Preprocessor() = default;
+    explicit Preprocessor(const PreprocessOptions& o) : options(o) {}
+
+    int8_t lit_value(Lit l) const { return lit_neg(l) ? int8_t(-value[lit_var(l)]) : value[lit_var(l)]; }
+
+    // Occurrence lists are cleaned lazily: an entry is live only if the
+    // clause was not removed and still holds the literal.
+    bool holds(uint32_t ci, Lit l) const {
+        return !removed[ci] && std::binary_search(clauses[ci].begin(), clauses[ci].end(), l);
+    }
+
+    void assign(Lit l) {
+        if(lit_value(l) == -1)
+            unsat = true;
+        else if(lit_value(l) == 0) {
+            value[lit_var(l)] = lit_neg(l) ? -1 : 1;
+            units.push_back(l);
+            fixed++;
+        }
+    }
+
+    void add(Clause c) {
+        std::sort(c.begin(), c.end());
+        c.erase(std::unique(c.begin(), c.end()), c.end());
+        size_t k = 0;
+        for(size_t i = 0; i < c.size(); i++) {
+            if(lit_value(c[i]) == 1 || (i && c[i] == lit_not(c[i - 1])))
+                return;
+            if(lit_value(c[i]) == 0)
+                c[k++] = c[i];
+        }
+        c.resize(k);
+        if(c.empty()) {
+            unsat = true;
+            return;
+        }
+        if(c.size() == 1) {
+            assign(c[0]);
+            return;
+        }
+        uint32_t ci = uint32_t(clauses.size());
+        for(Lit l : c)
+            occurs[l].push_back(ci);
+        clauses.push_back(std::move(c));
+        removed.push_back(false);
+    }
+
+    // Drops `l` from clause ci.
+    void strengthen(uint32_t ci, Lit l) {
+        Clause& c = clauses[ci];
+        c.erase(std::lower_bound(c.begin(), c.end(), l));
+        strengthened++;
+        if(c.size() == 1) {
+            assign(c[0]);
+            removed[ci] = true;
+        }
+    }
+
+    void propagate() {
+        while(!units.empty() && !unsat) {
+            Lit l = units.back();
+            units.pop_back();
+            for(uint32_t ci : occurs[l])
+                if(holds(ci, l))
+                    removed[ci] = true;
+            for(uint32_t ci : occurs[lit_not(l)])
+                if(holds(ci, lit_not(l)))
+                    strengthen(ci, lit_not(l));
+        }
+    }
+
+    // With the literals of c marked: `Subsumes` if c subsumes d, the literal
+    // of d that self-subsuming resolution removes if c subsumes d with one
+    // literal flipped, NoLit otherwise.
+    static constexpr Lit Subsumes = NoLit - 1;
+
+    Lit check(const Clause& c, const Clause& d) const {
+        size_t matched = 0;
+        Lit flipped = NoLit;
+        for(Lit l : d) {
+            if(mark[l])
+                matched++;
+            else if(mark[lit_not(l)]) {
+                if(flipped != NoLit)
+                    return NoLit;
+                flipped = l;
+            }
+        }
+        if(matched + (flipped != NoLit) != c.size())
+            return NoLit;
+        return flipped == NoLit ? Subsumes : flipped;
+    }
+
+    // Backward subsumption and strengthening: every clause, shortest first,
+    // is checked against the clauses sharing its least frequent variable.
+    // Strengthened clauses are checked again.
+    void subsume(Clock::time_point deadline) {
+        std::vector<uint32_t> queue;
+        for(uint32_t ci = 0; ci < clauses.size(); ci++)
+            if(!removed[ci])
+                queue.push_back(ci);
+        std::sort(queue.begin(), queue.end(), [&](uint32_t a, uint32_t b) { return clauses[a].size() < clauses[b].size(); });
+
+        for(size_t q = 0; q < queue.size() && !unsat; q++) {
+            if((q & 255) == 0 && Clock::now() > deadline)
+                break;
+            uint32_t ci = queue[q];
+            if(removed[ci])
+                continue;
+            Clause c = clauses[ci];
+            Lit best = c[0];
+            for(Lit l : c)
+                if(occurs[l].size() + occurs[lit_not(l)].size() < occurs[best].size() + occurs[lit_not(best)].size())
+                    best = l;
+            for(Lit l : c)
+                mark[l] = 1;
+            for(Lit side : {best, lit_not(best)}) {
+                for(size_t k = 0; k < occurs[side].size(); k++) {
+                    uint32_t di = occurs[side][k];
+                    if(di == ci || !holds(di, side) || clauses[di].size() < c.size())
+                        continue;
+                    Lit r = check(c, clauses[di]);
+                    if(r == Subsumes) {
+                        removed[di] = true;
+                        subsumed++;
+                    }
+                    else if(r != NoLit) {
+                        strengthen(di, r);
+                        if(!removed[di])
+                            queue.push_back(di);
+                    }
+                }
+            }
+            for(Lit l : c)
+                mark[l] = 0;
+            propagate();
+        }
+    }
+
+    // Resolvent of p and n on v; false if it is a tautology.
+    static bool resolve(const Clause& p, const Clause& n, Var v, Clause& out) {
+        out.clear();
+        size_t i = 0, j = 0;
+        while(i < p.size() || j < n.size()) {
+            Lit l;
+            if(j == n.size() || (i < p.size() && p[i] < n[j]))
+                l = p[i++];
+            else if(i == p.size() || n[j] < p[i])
+                l = n[j++];
+            else {
+                l = p[i++];
+                j++;
+            }
+            if(lit_var(l) == v)
+                continue;
+            if(!out.empty() && out.back() == lit_not(l))
+                return false;
+            out.push_back(l);
+        }
+        return true;
+    }
+
+    // Bounded variable elimination: a variable is replaced by its resolvents
+    // when they are no more clauses than the ones they replace.
+    void eliminate(Clock::time_point deadline) {
+        Var n_vars = Var(value.size());
+        std::vector<Var> order;
+        for(Var v = 0; v < n_vars; v++)
+            if(present[v])
+                order.push_back(v);
+        auto occ = [&](Var v) { return occurs[make_lit(v, false)].size() + occurs[make_lit(v, true)].size(); };
+        std::sort(order.begin(), order.end(), [&](Var a, Var b) { return occ(a) < occ(b); });
+
+        std::vector<uint32_t> pos, neg;
+        std::vector<Clause> resolvents;
+        Clause r;
+        for(size_t k = 0; k < order.size() && !unsat; k++) {
+            if((k & 63) == 0 && Clock::now() > deadline)
+                break;
+            Var v = order[k];
+            if(value[v] || eliminated[v])
+                continue;
+            pos.clear();
+            neg.clear();
+            for(uint32_t ci : occurs[make_lit(v, false)])
+                if(holds(ci, make_lit(v, false)))
+                    pos.push_back(ci);
+            for(uint32_t ci : occurs[make_lit(v, true)])
+                if(holds(ci, make_lit(v, true)))
+                    neg.push_back(ci);
+            if(pos.size() > options.occurrence_limit || neg.size() > options.occurrence_limit)
+                continue;
+
+            resolvents.clear();
+            bool ok = true;
+            for(size_t i = 0; i < pos.size() && ok; i++)
+                for(size_t j = 0; j < neg.size() && ok; j++) {
+                    if(!resolve(clauses[pos[i]], clauses[neg[j]], v, r))
+                        continue;
+                    resolvents.push_back(r);
+                    ok = r.size() <= options.resolvent_limit && resolvents.size() <= pos.size() + neg.size();
+                }
+            if(!ok)
+                continue;
+
+            for(const auto* side : {&pos, &neg})
+                for(uint32_t ci : *side) {
+                    elim_stack.push_back({side == &pos ? make_lit(v, false) : make_lit(v, true), clauses[ci]});
+                    removed[ci] = true;
+                }
+            eliminated[v] = true;
+            eliminated_vars++;
+            for(auto& c : resolvents)
+                add(std::move(c));
+            propagate();
+        }
+    }
+
+    NormalForm run(const NormalForm& cnf) {
+        TRACE_SCOPE("preprocess");
+        Var n_vars = 0;
+        for(Lit l : cnf.lits)
+            n_vars = std::max(n_vars, lit_var(l) + 1);
+        value.assign(n_vars, 0);
+        present.assign(n_vars, false);
+        eliminated.assign(n_vars, false);
+        occurs.assign(2 * size_t(n_vars), {});
+        mark.assign(2 * size_t(n_vars), 0);
+        for(Lit l : cnf.lits)
+            present[lit_var(l)] = true;
+        for(ClauseView c : cnf)
+            add(Clause(c.begin(), c.end()));
+        propagate();
+
+        auto deadline = [](double ms) {
+            return Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+        };
+        if(!unsat)
+            subsume(deadline(options.subsume_ms));
+        if(!unsat)
+            eliminate(deadline(options.eliminate_ms));
+
+        NormalForm out;
+        if(unsat) {
+            out.push_back({});
+            return out;
+        }
+        for(Var v = 0; v < n_vars; v++)
+            if(value[v])
+                out.push_back({make_lit(v, value[v] < 0)});
+        for(size_t ci = 0; ci < clauses.size(); ci++)
+            if(!removed[ci])
+                out.push_back(clauses[ci]);
+        return out;
+    }
+
+    // Completes a model of the preprocessed CNF (+1 / -1 / 0 per variable)
+    // for the input: variables that disappeared default to false and
+    // eliminated ones are set from their saved clauses, latest first.
+    void extend(std::vector<int8_t>& model) const {
+        if(model.size() < present.size())
+            model.resize(present.size(), 0);
+        for(Var v = 0; v < present.size(); v++)
+            if(present[v] && !model[v])
+                model[v] = -1;
+        for(auto it = elim_stack.rbegin(); it != elim_stack.rend(); ++it) {
+            bool satisfied = false;
+            for(Lit l : it->second)
+                if((model[lit_var(l)] > 0) != lit_neg(l)) {
+                    satisfied = true;
+                    break;
+                }
+            if(!satisfied)
+                model[lit_var(it->first)] = lit_neg(it->first) ? -1 : 1;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "formula.hpp"
+
+#include <queue>
+
+// Bit-parallel simulation of a cone: every node holds `words` 64-bit words,
+// bit i of which is its value under the i-th input pattern. The per-node
+// loops run over contiguous words so the compiler can vectorize them.
+struct Simulation {
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> slot;
+    size_t words = 0;
+    std::vector<uint64_t> values;
+
+    uint64_t* row(uint32_t id) { return &values[slot[id] * words]; }
+    const uint64_t* row(uint32_t id) const { return &values[slot[id] * words]; }
+
+    bool bit(uint32_t id, size_t i) const { return (row(id)[i >> 6] >> (i & 63)) & 1; }
+
+    // `input(var, out)` writes the `words` pattern words of an atom.
+    template<typename Input>
+    void run(const std::vector<FormulaPtr>& roots, size_t n_words, Input&& input) {
+        order = cone(roots);
+        words = n_words;
+        slot.assign(store().nodes.size(), 0);
+        for(size_t k = 0; k < order.size(); k++)
+            slot[order[k]] = uint32_t(k);
+        values.assign(order.size() * words, 0);
+
+        for(size_t k = 0; k < order.size(); k++) {
+            const Formula& node = *FormulaPtr{order[k]};
+            uint64_t* out = &values[k * words];
+            if(std::holds_alternative<True>(node))
+                std::fill(out, out + words, ~uint64_t(0));
+            else if(std::holds_alternative<Atom>(node))
+                input(std::get<Atom>(node).var, out);
+            else if(std::holds_alternative<Not>(node)) {
+                const uint64_t* a = row(std::get<Not>(node).subformula.id);
+                for(size_t w = 0; w < words; w++)
+                    out[w] = ~a[w];
+            }
+            else if(std::holds_alternative<Binary>(node)) {
+                const Binary& b = std::get<Binary>(node);
+                const uint64_t* l = row(b.left.id);
+                const uint64_t* r = row(b.right.id);
+                switch(b.type) {
+                    case Binary::And:
+                        for(size_t w = 0; w < words; w++) out[w] = l[w] & r[w];
+                        break;
+                    case Binary::Or:
+                        for(size_t w = 0; w < words; w++) out[w] = l[w] | r[w];
+                        break;
+                    case Binary::Impl:
+                        for(size_t w = 0; w < words; w++) out[w] = ~l[w] | r[w];
+                        break;
+                    case Binary::Eq:
+                        for(size_t w = 0; w < words; w++) out[w] = ~(l[w] ^ r[w]);
+                        break;
+                    case Binary::Xor:
+                        for(size_t w = 0; w < words; w++) out[w] = l[w] ^ r[w];
+                        break;
+                    case Binary::Nand:
+                        for(size_t w = 0; w < words; w++) out[w] = ~(l[w] & r[w]);
+                        break;
+                    case Binary::Nor:
+                        for(size_t w = 0; w < words; w++) out[w] = ~(l[w] | r[w]);
+                        break;
+                }
+            }
+        }
+    }
+};
+
+// Values of the k-th atom in name order (bit k of the row index) over the
+// truth-table rows [64 * first_word, 64 * (first_word + words)). Row indices
+// fit in 64 bits, so atoms from k = 64 on are false in every row.
+void exhaustive_pattern(size_t k, size_t first_word, size_t words, uint64_t* out) {
+    static const uint64_t low[6] = {
+        0xAAAAAAAAAAAAAAAAull, 0xCCCCCCCCCCCCCCCCull, 0xF0F0F0F0F0F0F0F0ull,
+        0xFF00FF00FF00FF00ull, 0xFFFF0000FFFF0000ull, 0xFFFFFFFF00000000ull
+    };
+    for(size_t w = 0; w < words; w++)
+        out[w] = k < 6 ? low[k] : (k < 70 && (((first_word + w) >> (k - 6)) & 1) ? ~uint64_t(0) : 0);
+}
+
+// Random pattern word w of variable v, a pure function of its arguments so
+// the patterns do not depend on the order atoms are met (splitmix64).
+uint64_t random_pattern(uint64_t seed, Var v, size_t w) {
+    uint64_t z = seed + uint64_t(v) * 0x9E3779B97F4A7C15ull + w * 0xD1B54A32D192ED03ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Simulates f and g together on up to `patterns` random input patterns,
+// `chunk` words at a time, and stops at the first pattern on which they
+// differ. Returns true and sets cex to that pattern over the atoms of f and
+// g; false means simulation found no difference.
+bool find_difference(const FormulaPtr& f, const FormulaPtr& g, size_t patterns, Valuation& cex,
+                     uint64_t seed = 1, size_t chunk = 8) {
+    if(f == g)
+        return false;
+    Simulation sim;
+    for(size_t first = 0; first < (patterns + 63) / 64; first += chunk) {
+        size_t words = std::min(chunk, (patterns + 63) / 64 - first);
+        sim.run({f, g}, words, [&](Var v, uint64_t* out) {
+            for(size_t w = 0; w < words; w++)
+                out[w] = random_pattern(seed, v, first + w);
+        });
+        const uint64_t* a = sim.row(f.id);
+        const uint64_t* b = sim.row(g.id);
+        for(size_t w = 0; w < words; w++) {
+            uint64_t diff = a[w] ^ b[w];
+            if(!diff)
+                continue;
+            size_t i = 64 * w + __builtin_ctzll(diff);
+            cex.clear();
+            for(uint32_t id : sim.order)
+                if(is<Atom>(FormulaPtr{id}))
+                    cex[as<Atom>(FormulaPtr{id}).name] = sim.bit(id, i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Scalar evaluator for streamed valuations: after an atom flips only its
+// transitive fanout is re-evaluated, in topological order. Atoms are
+// addressed by their index in the enumerator's atom list, resolved once
+// here, so flipping never touches the formula store.
+struct IncrementalEvaluator {
+    static constexpr uint32_t NoSlot = UINT32_MAX;
+
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> slot;
+    std::vector<uint32_t> atom_slot;
+    std::vector<std::vector<uint32_t>> fanout;
+    std::vector<uint8_t> value;
+    std::vector<uint8_t> queued;
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> dirty;
+
+    IncrementalEvaluator(const std::vector<FormulaPtr>& roots, const ValuationEnumerator& e) : order(cone(roots)) {
+        slot.assign(store().nodes.size(), NoSlot);
+        for(size_t k = 0; k < order.size(); k++)
+            slot[order[k]] = uint32_t(k);
+        atom_slot.assign(e.atoms.size(), NoSlot);
+        for(size_t k = 0; k < e.atoms.size(); k++) {
+            auto it = vars().ids.find(e.atoms[k]);
+            if(it != vars().ids.end() && it->second < store().atom_nodes.size()) {
+                uint32_t id = store().atom_nodes[it->second];
+                if(id != FormulaPtr::None)
+                    atom_slot[k] = slot[id];
+            }
+        }
+        fanout.resize(order.size());
+        value.assign(order.size(), 0);
+        queued.assign(order.size(), 0);
+        for(uint32_t k = 0; k < order.size(); k++) {
+            const Formula& node = *FormulaPtr{order[k]};
+            if(std::holds_alternative<Not>(node))
+                fanout[slot[std::get<Not>(node).subformula.id]].push_back(k);
+            else if(std::holds_alternative<Binary>(node)) {
+                fanout[slot[std::get<Binary>(node).left.id]].push_back(k);
+                fanout[slot[std::get<Binary>(node).right.id]].push_back(k);
+            }
+            if(std::holds_alternative<Atom>(node)) {
+                auto it = e.current().find(std::get<Atom>(node).name);
+                value[k] = it != e.current().end() && it->second;
+            }
+            else
+                value[k] = compute(k);
+        }
+    }
+
+    bool compute(uint32_t k) const {
+        const Formula& node = *FormulaPtr{order[k]};
+        if(std::holds_alternative<True>(node))
+            return true;
+        if(std::holds_alternative<Not>(node))
+            return !value[slot[std::get<Not>(node).subformula.id]];
+        if(std::holds_alternative<Binary>(node)) {
+            const Binary& b = std::get<Binary>(node);
+            bool l = value[slot[b.left.id]], r = value[slot[b.right.id]];
+            switch(b.type) {
+                case Binary::And:  return l && r;
+                case Binary::Or:   return l || r;
+                case Binary::Impl: return !l || r;
+                case Binary::Eq:   return l == r;
+                case Binary::Xor:  return l != r;
+                case Binary::Nand: return !(l && r);
+                case Binary::Nor:  return !(l || r);
+            }
+        }
+        return value[k];
+    }
+
+    bool operator[](const FormulaPtr& f) const { return value[slot[f.id]]; }
+
+    // Flips atom k of the enumerator; atoms outside the cone are ignored.
+    void flip(size_t atom) {
+        uint32_t k = atom_slot[atom];
+        if(k == NoSlot)
+            return;
+        value[k] = !value[k];
+        for(uint32_t s : fanout[k])
+            if(!queued[s]) {
+                queued[s] = 1;
+                dirty.push(s);
+            }
+        while(!dirty.empty()) {
+            uint32_t d = dirty.top();
+            dirty.pop();
+            queued[d] = 0;
+            bool nv = compute(d);
+            if(nv == bool(value[d]))
+                continue;
+            value[d] = nv;
+            for(uint32_t s : fanout[d])
+                if(!queued[s]) {
+                    queued[s] = 1;
+                    dirty.push(s);
+                }
+        }
+    }
+};
+
+// Streams the valuations of Gray-code steps [first_step, first_step + count)
+// over the atoms of f into cb(row, valuation, evaluator), without
+// materializing the truth table.
+template<typename Callback>
+void for_each_valuation(const FormulaPtr& f, uint64_t first_step, uint64_t count, Callback&& cb) {
+    AtomSet atoms;
+    getAtoms(f, atoms);
+    ValuationEnumerator e(atoms, first_step);
+    if(count == 0 || first_step >= e.count())
+        return;
+    IncrementalEvaluator eval({f}, e);
+    for(uint64_t i = 0;;) {
+        cb(e.row(), e.current(), eval);
+        if(++i == count)
+            break;
+        int k = e.next();
+        if(k < 0)
+            break;
+        eval.flip(size_t(k));
+    }
+}
+
+#endif
@@ -0,0 +1,641 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "normalform.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <random>
+
+enum class SatResult { Unknown, Sat, Unsat };
+
+struct SolverOptions {
+    enum Restarts { Luby, Geometric };
+    enum Phase { PhaseFalse, PhaseTrue, PhaseRandom };
+
+    uint64_t seed = 0;
+    Restarts restarts = Luby;
+    Phase phase = PhaseFalse;
+    double random_freq = 0;
+};
+
+// Short learnt clauses published by portfolio members for the others.
+struct ClauseExchange {
+    std::mutex m;
+    std::vector<std::pair<size_t, std::vector<Lit>>> clauses;
+
+    void publish(size_t from, const std::vector<Lit>& ps) {
+        std::lock_guard<std::mutex> lock(m);
+        clauses.emplace_back(from, ps);
+    }
+
+    // Appends to `out` the clauses of other members published since `cursor`.
+    void collect(size_t me, size_t& cursor, std::vector<std::vector<Lit>>& out) {
+        std::lock_guard<std::mutex> lock(m);
+        for(; cursor < clauses.size(); cursor++)
+            if(clauses[cursor].first != me)
+                out.push_back(clauses[cursor].second);
+    }
+};
+
+// CDCL solver in the MiniSat mould: two watched literals with blockers,
+// VSIDS, phase saving, first-UIP learning with recursive minimization,
+// Luby restarts and LBD-based learnt clause reduction.
+struct Solver {
+    using CRef = uint32_t;
+    static constexpr CRef NoRef = UINT32_MAX;
+
+    enum : uint32_t { Learnt = 1, Deleted = 2, Reloc = 4, LbdShift = 3 };
+
+    struct Watcher { CRef cref; Lit blocker; };
+
+    // Clauses live in one arena as [size, flags, lits...].
+    std::vector<uint32_t> arena;
+    size_t wasted = 0;
+    std::vector<CRef> clauses, learnts;
+
+    std::vector<std::vector<Watcher>> watches;
+    std::vector<int8_t> assigns;
+    std::vector<int> level;
+    std::vector<CRef> reason;
+    std::vector<uint8_t> polarity;
+    std::vector<double> activity;
+    std::vector<uint8_t> seen;
+    std::vector<Lit> trail;
+    std::vector<size_t> trail_lim;
+    size_t qhead = 0;
+    bool ok = true;
+
+    std::vector<Var> heap;
+    std::vector<int> heap_index;
+
+    std::vector<Lit> analyze_stack, analyze_toclear, learnt_clause;
+    std::vector<uint64_t> level_stamp;
+    uint64_t stamp = 0;
+
+    double var_inc = 1, var_decay = 0.95;
+    double max_learnts = 0;
+    int restart_first = 100;
+
+    SolverOptions options;
+    std::mt19937_64 rng;
+    const std::atomic<bool>* stop = nullptr;
+    uint64_t conflict_budget = UINT64_MAX;
+
+    ClauseExchange* exchange = nullptr;
+    size_t exchange_id = 0, exchange_cursor = 0;
+    uint32_t share_lbd = 2, share_size = 8;
+    std::vector<std::vector<Lit>> imported;
+
+    Solver() = default;
+    explicit Solver(const SolverOptions& o) : options(o), rng(o.seed) {}
+
+    uint64_t conflicts = 0, decisions = 0, propagations = 0, restarts = 0;
+    std::vector<int8_t> model;
+    std::vector<Lit> assumptions;
+
+    size_t num_vars() const { return assigns.size(); }
+    int decision_level() const { return int(trail_lim.size()); }
+
+    int8_t value(Lit p) const {
+        int8_t v = assigns[lit_var(p)];
+        return lit_neg(p) ? int8_t(-v) : v;
+    }
+
+    uint32_t size(CRef c) const { return arena[c]; }
+    Lit* lits(CRef c) { return &arena[c + 2]; }
+    bool is_learnt(CRef c) const { return arena[c + 1] & Learnt; }
+    uint32_t lbd(CRef c) const { return arena[c + 1] >> LbdShift; }
+
+    Var new_var() {
+        Var v = Var(num_vars());
+        assigns.push_back(0);
+        level.push_back(0);
+        reason.push_back(NoRef);
+        polarity.push_back(options.phase == SolverOptions::PhaseTrue ? 0 :
+                           options.phase == SolverOptions::PhaseRandom ? rng() & 1 : 1);
+        activity.push_back(options.seed ? double(rng() % 1000) * 1e-6 : 0);
+        seen.push_back(0);
+        heap_index.push_back(-1);
+        watches.emplace_back();
+        watches.emplace_back();
+        level_stamp.push_back(0);
+        heap_insert(v);
+        return v;
+    }
+
+    // Heap of unassigned variables ordered by activity.
+    bool heap_less(Var a, Var b) const { return activity[a] > activity[b]; }
+
+    void heap_up(int i) {
+        Var v = heap[i];
+        while(i > 0) {
+            int p = (i - 1) / 2;
+            if(!heap_less(v, heap[p]))
+                break;
+            heap[i] = heap[p];
+            heap_index[heap[i]] = i;
+            i = p;
+        }
+        heap[i] = v;
+        heap_index[v] = i;
+    }
+
+    void heap_down(int i) {
+        Var v = heap[i];
+        int n = int(heap.size());
+        for(;;) {
+            int c = 2 * i + 1;
+            if(c >= n)
+                break;
+            if(c + 1 < n && heap_less(heap[c + 1], heap[c]))
+                c++;
+            if(!heap_less(heap[c], v))
+                break;
+            heap[i] = heap[c];
+            heap_index[heap[i]] = i;
+            i = c;
+        }
+        heap[i] = v;
+        heap_index[v] = i;
+    }
+
+    void heap_insert(Var v) {
+        if(heap_index[v] >= 0)
+            return;
+        heap.push_back(v);
+        heap_up(int(heap.size()) - 1);
+    }
+
+    Var heap_pop() {
+        Var top = heap[0];
+        heap_index[top] = -1;
+        Var last = heap.back();
+        heap.pop_back();
+        if(!heap.empty()) {
+            heap[0] = last;
+            heap_index[last] = 0;
+            heap_down(0);
+        }
+        return top;
+    }
+
+    void bump(Var v) {
+        if((activity[v] += var_inc) > 1e100) {
+            for(auto& a : activity)
+                a *= 1e-100;
+            var_inc *= 1e-100;
+        }
+        if(heap_index[v] >= 0)
+            heap_up(heap_index[v]);
+    }
+
+    CRef alloc(const std::vector<Lit>& ps, bool learnt, uint32_t glue = 0) {
+        CRef c = CRef(arena.size());
+        arena.push_back(uint32_t(ps.size()));
+        arena.push_back((learnt ? uint32_t(Learnt) : 0u) | (glue << LbdShift));
+        arena.insert(arena.end(), ps.begin(), ps.end());
+        return c;
+    }
+
+    void attach(CRef c) {
+        Lit* l = lits(c);
+        watches[lit_not(l[0])].push_back({c, l[1]});
+        watches[lit_not(l[1])].push_back({c, l[0]});
+    }
+
+    bool locked(CRef c) {
+        Lit first = lits(c)[0];
+        return value(first) == 1 && reason[lit_var(first)] == c;
+    }
+
+    void enqueue(Lit p, CRef from) {
+        Var v = lit_var(p);
+        assigns[v] = lit_neg(p) ? -1 : 1;
+        level[v] = decision_level();
+        reason[v] = from;
+        trail.push_back(p);
+    }
+
+    bool add_clause(std::vector<Lit> ps) {
+        if(!ok)
+            return false;
+        std::sort(ps.begin(), ps.end());
+        size_t j = 0;
+        for(size_t i = 0; i < ps.size(); i++) {
+            if(value(ps[i]) == 1 || (j > 0 && ps[i] == lit_not(ps[j - 1])))
+                return true;
+            if(value(ps[i]) != -1 && (j == 0 || ps[i] != ps[j - 1]))
+                ps[j++] = ps[i];
+        }
+        ps.resize(j);
+
+        if(ps.empty())
+            return ok = false;
+        if(ps.size() == 1) {
+            enqueue(ps[0], NoRef);
+            return ok = (propagate() == NoRef);
+        }
+        CRef c = alloc(ps, false);
+        clauses.push_back(c);
+        attach(c);
+        return true;
+    }
+
+    CRef propagate() {
+        CRef confl = NoRef;
+        while(qhead < trail.size()) {
+            Lit p = trail[qhead++];
+            Lit false_lit = lit_not(p);
+            auto& ws = watches[p];
+            size_t i = 0, j = 0, n = ws.size();
+            propagations++;
+            while(i < n) {
+                Watcher w = ws[i];
+                if(value(w.blocker) == 1) {
+                    ws[j++] = ws[i++];
+                    continue;
+                }
+                CRef cr = w.cref;
+                Lit* c = lits(cr);
+                if(c[0] == false_lit)
+                    std::swap(c[0], c[1]);
+                i++;
+
+                Lit first = c[0];
+                Watcher nw{cr, first};
+                if(first != w.blocker && value(first) == 1) {
+                    ws[j++] = nw;
+                    continue;
+                }
+
+                bool moved = false;
+                for(uint32_t k = 2, sz = size(cr); k < sz; k++) {
+                    if(value(c[k]) != -1) {
+                        c[1] = c[k];
+                        c[k] = false_lit;
+                        watches[lit_not(c[1])].push_back(nw);
+                        moved = true;
+                        break;
+                    }
+                }
+                if(moved)
+                    continue;
+
+                ws[j++] = nw;
+                if(value(first) == -1) {
+                    confl = cr;
+                    qhead = trail.size();
+                    while(i < n)
+                        ws[j++] = ws[i++];
+                }
+                else
+                    enqueue(first, cr);
+            }
+            ws.resize(j);
+        }
+        return confl;
+    }
+
+    uint32_t abstract_level(Var v) const { return 1u << (level[v] & 31); }
+
+    bool lit_redundant(Lit p, uint32_t levels) {
+        analyze_stack.clear();
+        analyze_stack.push_back(p);
+        size_t top = analyze_toclear.size();
+        while(!analyze_stack.empty()) {
+            CRef cr = reason[lit_var(analyze_stack.back())];
+            analyze_stack.pop_back();
+            Lit* c = lits(cr);
+            for(uint32_t k = 1, sz = size(cr); k < sz; k++) {
+                Var v = lit_var(c[k]);
+                if(seen[v] || level[v] == 0)
+                    continue;
+                if(reason[v] != NoRef && (abstract_level(v) & levels)) {
+                    seen[v] = 1;
+                    analyze_stack.push_back(c[k]);
+                    analyze_toclear.push_back(c[k]);
+                }
+                else {
+                    for(size_t t = top; t < analyze_toclear.size(); t++)
+                        seen[lit_var(analyze_toclear[t])] = 0;
+                    analyze_toclear.resize(top);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // First-UIP conflict analysis. Leaves the learnt clause in learnt_clause
+    // with the asserting literal first and returns the backjump level.
+    int analyze(CRef confl) {
+        auto& out = learnt_clause;
+        out.clear();
+        out.push_back(NoLit);
+        int path = 0;
+        Lit p = NoLit;
+        size_t index = trail.size();
+
+        do {
+            Lit* c = lits(confl);
+            for(uint32_t k = (p == NoLit ? 0 : 1), sz = size(confl); k < sz; k++) {
+                Var v = lit_var(c[k]);
+                if(seen[v] || level[v] == 0)
+                    continue;
+                bump(v);
+                seen[v] = 1;
+                if(level[v] >= decision_level())
+                    path++;
+                else
+                    out.push_back(c[k]);
+            }
+            while(!seen[lit_var(trail[--index])]);
+            p = trail[index];
+            confl = reason[lit_var(p)];
+            seen[lit_var(p)] = 0;
+            path--;
+        } while(path > 0);
+        out[0] = lit_not(p);
+
+        analyze_toclear.assign(out.begin(), out.end());
+        uint32_t levels = 0;
+        for(size_t i = 1; i < out.size(); i++)
+            levels |= abstract_level(lit_var(out[i]));
+        size_t j = 1;
+        for(size_t i = 1; i < out.size(); i++)
+            if(reason[lit_var(out[i])] == NoRef || !lit_redundant(out[i], levels))
+                out[j++] = out[i];
+        out.resize(j);
+        for(Lit l : analyze_toclear)
+            seen[lit_var(l)] = 0;
+
+        if(out.size() == 1)
+            return 0;
+        size_t max_i = 1;
+        for(size_t i = 2; i < out.size(); i++)
+            if(level[lit_var(out[i])] > level[lit_var(out[max_i])])
+                max_i = i;
+        std::swap(out[1], out[max_i]);
+        return level[lit_var(out[1])];
+    }
+
+    uint32_t compute_lbd(const std::vector<Lit>& ps) {
+        stamp++;
+        uint32_t n = 0;
+        for(Lit l : ps) {
+            int lv = level[lit_var(l)];
+            if(level_stamp[lv] != stamp) {
+                level_stamp[lv] = stamp;
+                n++;
+            }
+        }
+        return n;
+    }
+
+    void cancel_until(int lvl) {
+        if(decision_level() <= lvl)
+            return;
+        for(size_t c = trail.size(); c-- > trail_lim[lvl];) {
+            Var v = lit_var(trail[c]);
+            assigns[v] = 0;
+            reason[v] = NoRef;
+            polarity[v] = lit_neg(trail[c]);
+            heap_insert(v);
+        }
+        trail.resize(trail_lim[lvl]);
+        trail_lim.resize(lvl);
+        qhead = trail.size();
+    }
+
+    Lit pick_branch() {
+        if(options.random_freq > 0 && !heap.empty()
+           && std::uniform_real_distribution<double>(0, 1)(rng) < options.random_freq) {
+            Var v = heap[rng() % heap.size()];
+            if(assigns[v] == 0)
+                return make_lit(v, polarity[v]);
+        }
+        while(!heap.empty()) {
+            Var v = heap_pop();
+            if(assigns[v] == 0)
+                return make_lit(v, polarity[v]);
+        }
+        return NoLit;
+    }
+
+    void remove_clause(CRef c) {
+        arena[c + 1] |= Deleted;
+        wasted += size(c) + 2;
+    }
+
+    void reduce_db() {
+        std::sort(learnts.begin(), learnts.end(), [&](CRef a, CRef b) {
+            if(lbd(a) != lbd(b))
+                return lbd(a) > lbd(b);
+            return size(a) > size(b);
+        });
+        size_t half = learnts.size() / 2, j = 0;
+        for(size_t i = 0; i < learnts.size(); i++) {
+            CRef c = learnts[i];
+            if(i < half && lbd(c) > 2 && !locked(c))
+                remove_clause(c);
+            else
+                learnts[j++] = c;
+        }
+        learnts.resize(j);
+
+        for(auto& ws : watches)
+            ws.erase(std::remove_if(ws.begin(), ws.end(), [&](const Watcher& w) {
+                return arena[w.cref + 1] & Deleted;
+            }), ws.end());
+
+        if(wasted > arena.size() / 5)
+            collect_garbage();
+    }
+
+    // Compacts the arena, forwarding every live reference.
+    void collect_garbage() {
+        std::vector<uint32_t> to;
+        to.reserve(arena.size() - wasted);
+        auto relocate = [&](CRef& c) {
+            if(arena[c + 1] & Reloc) {
+                c = arena[c];
+                return;
+            }
+            CRef n = CRef(to.size());
+            to.insert(to.end(), arena.begin() + c, arena.begin() + c + 2 + size(c));
+            arena[c] = n;
+            arena[c + 1] |= Reloc;
+            c = n;
+        };
+        for(Lit p : trail) {
+            CRef& r = reason[lit_var(p)];
+            if(r != NoRef)
+                relocate(r);
+        }
+        for(auto& c : clauses)
+            relocate(c);
+        for(auto& c : learnts)
+            relocate(c);
+        for(auto& ws : watches)
+            for(auto& w : ws)
+                w.cref = arena[w.cref];
+        arena.swap(to);
+        wasted = 0;
+    }
+
+    static double luby(double y, uint64_t x) {
+        uint64_t size = 1;
+        int seq = 0;
+        while(size < x + 1) {
+            seq++;
+            size = 2 * size + 1;
+        }
+        while(size - 1 != x) {
+            size = (size - 1) >> 1;
+            seq--;
+            x = x % size;
+        }
+        return std::pow(y, seq);
+    }
+
+    SatResult search(uint64_t conflict_limit) {
+        uint64_t local_conflicts = 0;
+        for(;;) {
+            CRef confl = propagate();
+            if(confl != NoRef) {
+                conflicts++;
+                local_conflicts++;
+                if(decision_level() == 0) {
+                    ok = false;
+                    return SatResult::Unsat;
+                }
+                int back = analyze(confl);
+                cancel_until(back);
+                if(learnt_clause.size() == 1)
+                    enqueue(learnt_clause[0], NoRef);
+                else {
+                    uint32_t glue = compute_lbd(learnt_clause);
+                    CRef c = alloc(learnt_clause, true, glue);
+                    learnts.push_back(c);
+                    attach(c);
+                    enqueue(learnt_clause[0], c);
+                    if(exchange && glue <= share_lbd && learnt_clause.size() <= share_size)
+                        exchange->publish(exchange_id, learnt_clause);
+                }
+                var_inc /= var_decay;
+                continue;
+            }
+
+            if(local_conflicts >= conflict_limit || conflicts >= conflict_budget
+               || (stop && stop->load(std::memory_order_relaxed))) {
+                cancel_until(0);
+                return SatResult::Unknown;
+            }
+            if(double(learnts.size()) - double(trail.size()) >= max_learnts) {
+                reduce_db();
+                max_learnts *= 1.1;
+            }
+
+            // Assumption k is decided on level k + 1; one that is already
+            // false makes the problem unsatisfiable under the assumptions.
+            Lit next = NoLit;
+            while(decision_level() < int(assumptions.size())) {
+                Lit p = assumptions[decision_level()];
+                if(value(p) == 1)
+                    trail_lim.push_back(trail.size());
+                else if(value(p) == -1)
+                    return SatResult::Unsat;
+                else {
+                    next = p;
+                    break;
+                }
+            }
+            if(next == NoLit)
+                next = pick_branch();
+            if(next == NoLit)
+                return SatResult::Sat;
+            decisions++;
+            trail_lim.push_back(trail.size());
+            enqueue(next, NoRef);
+        }
+    }
+
+    // Solves under the given assumption literals. Clauses, learnt clauses
+    // and activities are kept, so further clauses may be added and solve
+    // called again; Unsat only means the clauses are unsatisfiable together
+    // with the assumptions.
+    SatResult solve(const std::vector<Lit>& assume = {}) {
+        model.clear();
+        if(!ok)
+            return SatResult::Unsat;
+        assumptions = assume;
+        for(Lit p : assumptions)
+            while(lit_var(p) >= num_vars())
+                new_var();
+        max_learnts = std::max({max_learnts, double(clauses.size()) / 3, 2000.0});
+
+        SatResult result = SatResult::Unknown;
+        while(result == SatResult::Unknown && conflicts < conflict_budget && !(stop && stop->load())) {
+            if(exchange && !import_shared())
+                return SatResult::Unsat;
+            double scale = options.restarts == SolverOptions::Luby ? luby(2, restarts) : std::pow(1.5, restarts);
+            restarts++;
+            result = search(uint64_t(scale * restart_first));
+        }
+        if(result == SatResult::Sat)
+            model = assigns;
+        cancel_until(0);
+        return result;
+    }
+
+    // Adds clauses learnt by other portfolio members; called at level 0.
+    bool import_shared() {
+        imported.clear();
+        exchange->collect(exchange_id, exchange_cursor, imported);
+        for(auto& ps : imported)
+            if(!add_clause(ps))
+                return false;
+        return true;
+    }
+
+    bool model_value(Var v) const { return model[v] > 0; }
+};
+
+struct SatAnswer {
+    SatResult result = SatResult::Unknown;
+    std::vector<int8_t> model;
+};
+
+void load(Solver& s, const NormalForm& cnf) {
+    for(Lit l : cnf.lits)
+        while(lit_var(l) >= s.num_vars())
+            s.new_var();
+    for(ClauseView clause : cnf)
+        if(!s.add_clause(Clause(clause.begin(), clause.end())))
+            break;
+}
+
+SatAnswer answer_of(Solver& s, SatResult result, const NormalForm& cnf) {
+    SatAnswer answer;
+    answer.result = result;
+    if(result == SatResult::Sat) {
+        answer.model.assign(s.num_vars(), 0);
+        for(Lit l : cnf.lits)
+            answer.model[lit_var(l)] = s.model[lit_var(l)];
+    }
+    return answer;
+}
+
+// Solves a CNF over VarTable variables; on SAT model[v] is +1/-1 for every
+// variable occurring in the CNF and 0 otherwise.
+SatAnswer solve(const NormalForm& cnf) {
+    Solver s;
+    load(s, cnf);
+    SatResult result = s.solve();
+    return answer_of(s, result, cnf);
+}
+
+#endif
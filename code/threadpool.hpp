@@ -0,0 +1,122 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: every worker owns a deque, runs its own tasks LIFO and
+// steals FIFO from the others when it runs dry.
+struct ThreadPool {
+    struct Queue {
+        std::mutex m;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex m;
+    std::condition_variable work_cv, idle_cv;
+    std::atomic<long> queued{0};
+    size_t pending = 0;
+    size_t next_queue = 0;
+    bool stopping = false;
+
+    static size_t& worker_index() {
+        thread_local size_t index = SIZE_MAX;
+        return index;
+    }
+
+    explicit ThreadPool(size_t workers) {
+        workers = std::max<size_t>(workers, 1);
+        for(size_t i = 0; i < workers; i++)
+            queues.push_back(std::make_unique<Queue>());
+        for(size_t i = 0; i < workers; i++)
+            threads.emplace_back([this, i] { work(i); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        work_cv.notify_all();
+        for(auto& t : threads)
+            t.join();
+    }
+
+    size_t size() const { return threads.size(); }
+
+    // Tasks submitted from a worker go to its own deque, others round-robin.
+    void submit(std::function<void()> task) {
+        size_t q = worker_index();
+        {
+            std::lock_guard<std::mutex> lock(m);
+            pending++;
+            if(q >= queues.size())
+                q = next_queue++ % queues.size();
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues[q]->m);
+            queues[q]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(m);
+            queued++;
+        }
+        work_cv.notify_one();
+    }
+
+    // Blocks until every submitted task has finished.
+    void wait() {
+        std::unique_lock<std::mutex> lock(m);
+        idle_cv.wait(lock, [this] { return pending == 0; });
+    }
+
+    bool take(size_t i, std::function<void()>& task) {
+        for(size_t k = 0; k < queues.size(); k++) {
+            Queue& q = *queues[(i + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.m);
+            if(q.tasks.empty())
+                continue;
+            if(k == 0) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+            else {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            queued--;
+            return true;
+        }
+        return false;
+    }
+
+    void work(size_t i) {
+        worker_index() = i;
+        std::function<void()> task;
+        for(;;) {
+            if(take(i, task)) {
+                task();
+                task = nullptr;
+                std::lock_guard<std::mutex> lock(m);
+                if(--pending == 0)
+                    idle_cv.notify_all();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m);
+            work_cv.wait(lock, [this] { return stopping || queued > 0; });
+            if(stopping && queued <= 0)
+                return;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Stage timers and counters. TRACE_SCOPE("name") times the enclosing block
+// and TRACE_COUNT(Counter, n) adds to a counter; both cost one relaxed load
+// while tracing is off and nothing at all when built with -DNO_TRACE.
+// Finished scopes are dumped as a Chrome / Perfetto trace (chrome://tracing,
+// ui.perfetto.dev) and summed up per name in a table.
+enum class Counter { NodesCreated, ClausesProduced, ClausesCleaned, BytesWritten, Count };
+
+const char* counter_name(Counter c) {
+    const char* names[] = {"nodes created", "clauses produced", "clauses removed by cleaning", "bytes written"};
+    return names[int(c)];
+}
+
+struct TraceEvent {
+    const char* name;
+    int64_t index;
+    uint32_t thread;
+    double start_us, duration_us;
+};
+
+struct Trace {
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<bool> enabled{false};
+    Clock::time_point origin = Clock::now();
+    std::mutex m;
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> counters[int(Counter::Count)] = {};
+    std::atomic<uint32_t> next_thread{0};
+
+    bool on() const { return enabled.load(std::memory_order_relaxed); }
+
+    void start() {
+        origin = Clock::now();
+        enabled = true;
+    }
+
+    double micros(Clock::time_point t) const { return std::chrono::duration<double, std::micro>(t - origin).count(); }
+
+    // Small stable id for the calling thread, used as the trace's tid.
+    uint32_t thread_id() {
+        thread_local uint32_t id = next_thread++;
+        return id;
+    }
+
+    void count(Counter c, uint64_t n) {
+        if(on())
+            counters[int(c)].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    void record(const char* name, int64_t index, Clock::time_point start, Clock::time_point end) {
+        TraceEvent e{name, index, thread_id(), micros(start), micros(end) - micros(start)};
+        std::lock_guard<std::mutex> lock(m);
+        events.push_back(e);
+    }
+
+    // Chrome trace event format: one complete ("X") event per scope and the
+    // final counter values as counter ("C") events.
+    void write_chrome(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(m);
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        double end = 0;
+        for(const TraceEvent& e : events) {
+            out << (first ? "\n" : ",\n") << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+                << std::fixed << std::setprecision(3) << ",\"ts\":" << e.start_us << ",\"dur\":" << e.duration_us;
+            if(e.index >= 0)
+                out << ",\"args\":{\"index\":" << e.index << "}";
+            out << "}";
+            first = false;
+            end = std::max(end, e.start_us + e.duration_us);
+        }
+        for(int c = 0; c < int(Counter::Count); c++) {
+            out << (first ? "\n" : ",\n") << "{\"name\":\"" << counter_name(Counter(c)) << "\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":"
+                << end << ",\"args\":{\"value\":" << counters[c].load() << "}}";
+            first = false;
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    }
+
+    // Calls, inclusive total, mean and worst time per scope name, then the
+    // counters.
+    void write_summary(std::ostream& out) {
+        struct Row { size_t calls = 0; double total = 0, worst = 0; int64_t worst_index = -1; };
+        std::map<std::string, Row> rows;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            for(const TraceEvent& e : events) {
+                Row& r = rows[e.name];
+                r.calls++;
+                r.total += e.duration_us / 1000;
+                if(e.duration_us / 1000 >= r.worst) {
+                    r.worst = e.duration_us / 1000;
+                    r.worst_index = e.index;
+                }
+            }
+        }
+        out << std::left << std::setw(14) << "stage" << std::right << std::setw(10) << "calls" << std::setw(14) << "total ms"
+            << std::setw(12) << "mean ms" << std::setw(12) << "max ms" << std::setw(10) << "max at" << "\n";
+        for(const auto& [name, r] : rows) {
+            out << std::left << std::setw(14) << name << std::right << std::setw(10) << r.calls << std::fixed << std::setprecision(3)
+                << std::setw(14) << r.total << std::setw(12) << r.total / r.calls << std::setw(12) << r.worst << std::setw(10);
+            if(r.worst_index >= 0)
+                out << r.worst_index;
+            else
+                out << "";
+            out << "\n";
+        }
+        for(int c = 0; c < int(Counter::Count); c++)
+            out << counter_name(Counter(c)) << ": " << counters[c].load() << "\n";
+    }
+};
+
+Trace& trace() {
+    static Trace t;
+    return t;
+}
+
+// Times its lifetime as one event; `index` (e.g. a batch pair) is attached
+// when non-negative.
+struct TraceScope {
+    const char* name;
+    int64_t index;
+    bool active;
+    Trace::Clock::time_point start;
+
+    explicit TraceScope(const char* n, int64_t i = -1) : name(n), index(i), active(trace().on()) {
+        if(active)
+            start = Trace::Clock::now();
+    }
+    ~TraceScope() {
+        if(active)
+            trace().record(name, index, start, Trace::Clock::now());
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+// Writes the Chrome trace to `path` and the summary table to `out`.
+void write_trace(const std::string& path, std::ostream& out) {
+#ifdef NO_TRACE
+    out << "Tracing was compiled out (NO_TRACE), " << path << " not written" << std::endl;
+#else
+    std::ofstream file(path);
+    if(!file) {
+        out << "Cannot open " << path << std::endl;
+        return;
+    }
+    trace().write_chrome(file);
+    out << "Trace written to " << path << "\n";
+    trace().write_summary(out);
+    out.flush();
+#endif
+}
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+
+#ifdef NO_TRACE
+#define TRACE_SCOPE(...) ((void)0)
+#define TRACE_COUNT(counter, n) ((void)0)
+#else
+#define TRACE_SCOPE(...) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
+#define TRACE_COUNT(counter, n) trace().count(Counter::counter, n)
+#endif
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef TRUTHTABLE_H
+#define TRUTHTABLE_H
+
+#include "simulation.hpp"
+
+#include <atomic>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TRUTHTABLE_X86 1
+#endif
+
+// Word kernels for truth-table evaluation, in a portable version and AVX2 /
+// AVX-512 versions chosen at run time from the CPU's features.
+enum class WordOp { And, Or, Impl, Eq, Xor, Nand, Nor, Not };
+enum class SimdLevel { Portable, Avx2, Avx512 };
+
+const char* simd_name(SimdLevel level) {
+    const char* names[] = {"portable", "avx2", "avx512"};
+    return names[int(level)];
+}
+
+// out = l op r over `words` words; r is unused for Not.
+void word_op_portable(WordOp op, const uint64_t* l, const uint64_t* r, uint64_t* out, size_t words) {
+    switch(op) {
+        case WordOp::And:  for(size_t w = 0; w < words; w++) out[w] = l[w] & r[w]; break;
+        case WordOp::Or:   for(size_t w = 0; w < words; w++) out[w] = l[w] | r[w]; break;
+        case WordOp::Impl: for(size_t w = 0; w < words; w++) out[w] = ~l[w] | r[w]; break;
+        case WordOp::Eq:   for(size_t w = 0; w < words; w++) out[w] = ~(l[w] ^ r[w]); break;
+        case WordOp::Xor:  for(size_t w = 0; w < words; w++) out[w] = l[w] ^ r[w]; break;
+        case WordOp::Nand: for(size_t w = 0; w < words; w++) out[w] = ~(l[w] & r[w]); break;
+        case WordOp::Nor:  for(size_t w = 0; w < words; w++) out[w] = ~(l[w] | r[w]); break;
+        case WordOp::Not:  for(size_t w = 0; w < words; w++) out[w] = ~l[w]; break;
+    }
+}
+
+// Index of the first word where a and b differ, or `words`.
+size_t first_difference_portable(const uint64_t* a, const uint64_t* b, size_t words) {
+    size_t w = 0;
+    while(w < words && a[w] == b[w])
+        w++;
+    return w;
+}
+
+#ifdef TRUTHTABLE_X86
+__attribute__((target("avx2")))
+void word_op_avx2(WordOp op, const uint64_t* l, const uint64_t* r, uint64_t* out, size_t words) {
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    size_t w = 0;
+    for(; w + 4 <= words; w += 4) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(l + w));
+        __m256i b = op == WordOp::Not ? a : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + w));
+        __m256i v;
+        switch(op) {
+            case WordOp::And:  v = _mm256_and_si256(a, b); break;
+            case WordOp::Or:   v = _mm256_or_si256(a, b); break;
+            case WordOp::Impl: v = _mm256_or_si256(_mm256_xor_si256(a, ones), b); break;
+            case WordOp::Eq:   v = _mm256_xor_si256(_mm256_xor_si256(a, b), ones); break;
+            case WordOp::Xor:  v = _mm256_xor_si256(a, b); break;
+            case WordOp::Nand: v = _mm256_xor_si256(_mm256_and_si256(a, b), ones); break;
+            case WordOp::Nor:  v = _mm256_xor_si256(_mm256_or_si256(a, b), ones); break;
+            default:           v = _mm256_xor_si256(a, ones); break;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + w), v);
+    }
+    word_op_portable(op, l + w, op == WordOp::Not ? l + w : r + w, out + w, words - w);
+}
+
+__attribute__((target("avx2")))
+size_t first_difference_avx2(const uint64_t* a, const uint64_t* b, size_t words) {
+    size_t w = 0;
+    for(; w + 4 <= words; w += 4) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + w)),
+                                     _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + w)));
+        if(!_mm256_testz_si256(x, x))
+            break;
+    }
+    return w + first_difference_portable(a + w, b + w, words - w);
+}
+
+__attribute__((target("avx512f")))
+void word_op_avx512(WordOp op, const uint64_t* l, const uint64_t* r, uint64_t* out, size_t words) {
+    const __m512i ones = _mm512_set1_epi64(-1);
+    size_t w = 0;
+    for(; w + 8 <= words; w += 8) {
+        __m512i a = _mm512_loadu_si512(l + w), b = op == WordOp::Not ? a : _mm512_loadu_si512(r + w);
+        __m512i v;
+        switch(op) {
+            case WordOp::And:  v = _mm512_and_si512(a, b); break;
+            case WordOp::Or:   v = _mm512_or_si512(a, b); break;
+            case WordOp::Impl: v = _mm512_or_si512(_mm512_xor_si512(a, ones), b); break;
+            case WordOp::Eq:   v = _mm512_xor_si512(_mm512_xor_si512(a, b), ones); break;
+            case WordOp::Xor:  v = _mm512_xor_si512(a, b); break;
+            case WordOp::Nand: v = _mm512_xor_si512(_mm512_and_si512(a, b), ones); break;
+            case WordOp::Nor:  v = _mm512_xor_si512(_mm512_or_si512(a, b), ones); break;
+            default:           v = _mm512_xor_si512(a, ones); break;
+        }
+        _mm512_storeu_si512(out + w, v);
+    }
+    word_op_portable(op, l + w, op == WordOp::Not ? l + w : r + w, out + w, words - w);
+}
+
+__attribute__((target("avx512f")))
+size_t first_difference_avx512(const uint64_t* a, const uint64_t* b, size_t words) {
+    size_t w = 0;
+    for(; w + 8 <= words; w += 8) {
+        __m512i x = _mm512_xor_si512(_mm512_loadu_si512(a + w), _mm512_loadu_si512(b + w));
+        if(_mm512_test_epi64_mask(x, x))
+            break;
+    }
+    return w + first_difference_portable(a + w, b + w, words - w);
+}
+#endif
+
+// One node of the cone to evaluate: a constant, the atom of rank `left`, or
+// a gate over the nodes at slots `left` and `right` (`right` unused for Not).
+struct TableNode {
+    enum Kind : uint8_t { Zero, One, Input, Gate } kind = Zero;
+    WordOp op = WordOp::Not;
+    uint32_t left = 0, right = 0;
+};
+
+struct WordKernels {
+    SimdLevel level;
+    void (*op)(WordOp, const uint64_t*, const uint64_t*, uint64_t*, size_t);
+    size_t (*first_difference)(const uint64_t*, const uint64_t*, size_t);
+};
+
+SimdLevel detect_simd() {
+#ifdef TRUTHTABLE_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f"))
+        return SimdLevel::Avx512;
+    if(__builtin_cpu_supports("avx2"))
+        return SimdLevel::Avx2;
+#endif
+    return SimdLevel::Portable;
+}
+
+// Kernels for `level`, falling back to portable ones where not compiled in.
+WordKernels word_kernels(SimdLevel level = detect_simd()) {
+#ifdef TRUTHTABLE_X86
+    if(level == SimdLevel::Avx512)
+        return {level, word_op_avx512, first_difference_avx512};
+    if(level == SimdLevel::Avx2)
+        return {level, word_op_avx2, first_difference_avx2};
+#endif
+    return {SimdLevel::Portable, word_op_portable, first_difference_portable};
+}
+
+// Compares f and g on every row of their joint truth table, where bit k of
+// a row is the value of the k-th atom in name order (as in
+// exhaustive_pattern). The table is evaluated in chunks of `chunk` words per
+// node; with more than one thread, chunks are dealt round-robin and every
+// thread stops once a difference was found before its next chunk. Returns
+// true and sets cex to the first differing row if f and g differ.
+bool exhaustive_difference(const FormulaPtr& f, const FormulaPtr& g, Valuation& cex, size_t threads = 0,
+                           const WordKernels& kernels = word_kernels()) {
+    if(f == g)
+        return false;
+    AtomSet atoms;
+    getAtoms(f, atoms);
+    getAtoms(g, atoms);
+    std::vector<std::string> names(atoms.begin(), atoms.end());
+    std::vector<size_t> rank(vars().size(), 0);
+    for(size_t k = 0; k < names.size(); k++)
+        rank[vars().intern(names[k])] = k;
+
+    // The formula store is thread-local, so the cone is flattened here and
+    // the workers only read `nodes`.
+    std::vector<uint32_t> order = cone({f, g});
+    std::vector<uint32_t> slot(store().nodes.size(), 0);
+    for(size_t k = 0; k < order.size(); k++)
+        slot[order[k]] = uint32_t(k);
+    const WordOp ops[] = {WordOp::And, WordOp::Or, WordOp::Impl, WordOp::Eq, WordOp::Xor, WordOp::Nand, WordOp::Nor};
+    std::vector<TableNode> nodes(order.size());
+    for(size_t k = 0; k < order.size(); k++) {
+        const Formula& node = *FormulaPtr{order[k]};
+        TableNode& n = nodes[k];
+        if(std::holds_alternative<True>(node))
+            n.kind = TableNode::One;
+        else if(std::holds_alternative<Atom>(node))
+            n = {TableNode::Input, WordOp::Not, uint32_t(rank[std::get<Atom>(node).var]), 0};
+        else if(std::holds_alternative<Not>(node))
+            n = {TableNode::Gate, WordOp::Not, slot[std::get<Not>(node).subformula.id], 0};
+        else if(std::holds_alternative<Binary>(node)) {
+            const Binary& b = std::get<Binary>(node);
+            n = {TableNode::Gate, ops[b.type], slot[b.left.id], slot[b.right.id]};
+        }
+    }
+    uint32_t f_slot = slot[f.id], g_slot = slot[g.id];
+
+    uint64_t rows = uint64_t(1) << names.size();
+    size_t total_words = size_t((rows + 63) / 64);
+    // About 16 MB of rows per thread, in whole AVX-512 vectors.
+    size_t chunk = std::clamp<size_t>((size_t(1) << 21) / order.size() / 8 * 8, 8, 1024);
+    chunk = std::min(chunk, total_words);
+    size_t n_chunks = (total_words + chunk - 1) / chunk;
+    if(threads == 0)
+        threads = rows >= (uint64_t(1) << 18) ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    threads = std::min(threads, n_chunks);
+    uint64_t valid = rows < 64 ? (uint64_t(1) << rows) - 1 : ~uint64_t(0);
+    std::atomic<uint64_t> first_row{rows};
+
+    auto worker = [&](size_t t) {
+        std::vector<uint64_t> values(nodes.size() * chunk);
+        for(size_t c = t; c < n_chunks; c += threads) {
+            size_t first_word = c * chunk, words = std::min(chunk, total_words - first_word);
+            if(64 * uint64_t(first_word) >= first_row.load(std::memory_order_relaxed))
+                return;
+            for(size_t k = 0; k < nodes.size(); k++) {
+                const TableNode& n = nodes[k];
+                uint64_t* out = &values[k * chunk];
+                switch(n.kind) {
+                    case TableNode::Zero:  std::fill(out, out + words, 0); break;
+                    case TableNode::One:   std::fill(out, out + words, ~uint64_t(0)); break;
+                    case TableNode::Input: exhaustive_pattern(n.left, first_word, words, out); break;
+                    case TableNode::Gate:
+                        kernels.op(n.op, &values[n.left * chunk], &values[n.right * chunk], out, words);
+                        break;
+                }
+            }
+            const uint64_t* a = &values[f_slot * chunk];
+            const uint64_t* b = &values[g_slot * chunk];
+            size_t w = kernels.first_difference(a, b, words);
+            if(w < words && ((a[w] ^ b[w]) & valid)) {
+                uint64_t r = 64 * uint64_t(first_word + w) + __builtin_ctzll((a[w] ^ b[w]) & valid);
+                uint64_t seen = first_row.load();
+                while(r < seen && !first_row.compare_exchange_weak(seen, r)) {}
+                return;
+            }
+        }
+    };
+    if(threads <= 1)
+        worker(0);
+    else {
+        std::vector<std::thread> workers;
+        for(size_t t = 0; t < threads; t++)
+            workers.emplace_back(worker, t);
+        for(auto& w : workers)
+            w.join();
+    }
+
+    uint64_t r = first_row.load();
+    if(r == rows)
+        return false;
+    cex.clear();
+    for(size_t k = 0; k < names.size(); k++)
+        cex[names[k]] = (r >> k) & 1;
+    return true;
+}
+
+#endif
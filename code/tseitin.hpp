@@ -0,0 +1,144 @@
+#ifndef TSEITIN_H
+#define TSEITIN_H
+
+#include "normalform.hpp"
+
+enum class CnfEncoding { Distribute, Tseitin, PlaistedGreenbaum };
+
+// Equisatisfiable CNF together with the auxiliary variables introduced for gates.
+struct EncodedCnf {
+    NormalForm cnf;
+    std::vector<Var> aux;
+
+    // Restricts a solver model to the original atoms.
+    Valuation project(const std::vector<int8_t>& model) const {
+        const VarTable& table = vars();
+        Valuation v;
+        for(Var x = 0; x < model.size(); x++)
+            if(model[x] && !table.aux[x])
+                v[table.name(x)] = model[x] > 0;
+        return v;
+    }
+};
+
+struct TseitinEncoder {
+    enum Polarity : uint8_t { Pos = 1, Neg = 2, Both = 3 };
+
+    bool polarity_aware;
+    EncodedCnf out;
+
+    explicit TseitinEncoder(bool pg) : polarity_aware(pg) {}
+
+    static uint8_t flip(uint8_t pol) { return uint8_t(((pol & Pos) << 1) | ((pol & Neg) >> 1)); }
+
+    void add(std::initializer_list<Lit> c) { out.cnf.push_back(c); }
+
+    // Two passes over the cone of f: the polarities every node is needed in
+    // are pushed from parents to operands in descending id order, then each
+    // gate gets its auxiliary variable and clauses in ascending order.
+    Lit encode(const FormulaPtr& f, uint8_t root_pol) {
+        std::vector<uint32_t> order = cone({f});
+        std::vector<uint8_t> pol(store().nodes.size(), 0);
+        std::vector<Lit> lits(store().nodes.size(), NoLit);
+        pol[f.id] = polarity_aware ? root_pol : uint8_t(Both);
+        for(auto it = order.rbegin(); it != order.rend(); ++it) {
+            FormulaPtr g{*it};
+            uint8_t p = pol[g.id];
+            if(is<Not>(g))
+                pol[as<Not>(g).subformula.id] |= flip(p);
+            else if(is<Binary>(g)) {
+                auto b = as<Binary>(g);
+                if(!polarity_aware || b.type == Binary::Eq || b.type == Binary::Xor)
+                    p = Both;
+                if(b.type == Binary::Nand || b.type == Binary::Nor)
+                    p = flip(p);
+                pol[b.left.id] |= b.type == Binary::Impl ? flip(p) : p;
+                pol[b.right.id] |= p;
+            }
+        }
+
+        for(uint32_t id : order) {
+            FormulaPtr g{id};
+            if(is<Atom>(g)) {
+                lits[id] = make_lit(as<Atom>(g).var, false);
+                continue;
+            }
+            if(is<Not>(g)) {
+                lits[id] = lit_not(lits[as<Not>(g).subformula.id]);
+                continue;
+            }
+            Var v = vars().fresh();
+            out.aux.push_back(v);
+            Lit x = make_lit(v, false), nx = lit_not(x);
+            lits[id] = x;
+
+            auto b = as<Binary>(g);
+            Lit l = lits[b.left.id], r = lits[b.right.id];
+            bool p = pol[id] & Pos, n = pol[id] & Neg;
+            switch(b.type) {
+                case Binary::And:
+                    if(p) { add({nx, l}); add({nx, r}); }
+                    if(n) add({x, lit_not(l), lit_not(r)});
+                    break;
+                case Binary::Or:
+                    if(p) add({nx, l, r});
+                    if(n) { add({x, lit_not(l)}); add({x, lit_not(r)}); }
+                    break;
+                case Binary::Impl:
+                    if(p) add({nx, lit_not(l), r});
+                    if(n) { add({x, l}); add({x, lit_not(r)}); }
+                    break;
+                case Binary::Eq:
+                    if(p) { add({nx, lit_not(l), r}); add({nx, l, lit_not(r)}); }
+                    if(n) { add({x, l, r}); add({x, lit_not(l), lit_not(r)}); }
+                    break;
+                case Binary::Xor:
+                    if(p) { add({nx, l, r}); add({nx, lit_not(l), lit_not(r)}); }
+                    if(n) { add({x, lit_not(l), r}); add({x, l, lit_not(r)}); }
+                    break;
+                case Binary::Nand:
+                    if(p) add({nx, lit_not(l), lit_not(r)});
+                    if(n) { add({x, l}); add({x, r}); }
+                    break;
+                case Binary::Nor:
+                    if(p) { add({nx, lit_not(l)}); add({nx, lit_not(r)}); }
+                    if(n) add({x, l, r});
+                    break;
+            }
+        }
+        return lits[f.id];
+    }
+};
+
+// Linear-size encoding: one auxiliary atom per gate. With polarity_aware set
+// only the implications required by the gate's polarity are emitted
+// (Plaisted-Greenbaum), otherwise both directions (Tseitin).
+EncodedCnf tseitin(const FormulaPtr& f, bool polarity_aware) {
+    TRACE_SCOPE("tseitin");
+    FormulaPtr s = simplify(f);
+    if(is<True>(s))
+        return {};
+    if(is<False>(s)) {
+        EncodedCnf out;
+        out.cnf.push_back({});
+        return out;
+    }
+
+    TseitinEncoder encoder(polarity_aware);
+    Lit root = encoder.encode(s, TseitinEncoder::Pos);
+    encoder.add({root});
+    TRACE_COUNT(ClausesProduced, encoder.out.cnf.size());
+    return std::move(encoder.out);
+}
+
+// `budget`, `report` and `threads` only apply to the Distribute encoding.
+EncodedCnf encode(const FormulaPtr& f, CnfEncoding encoding, size_t budget = DistributeBudget,
+                  DistributeReport* report = nullptr, size_t threads = 0) {
+    switch(encoding) {
+        case CnfEncoding::Tseitin:           return tseitin(f, false);
+        case CnfEncoding::PlaistedGreenbaum: return tseitin(f, true);
+        default:                             return {cnf(f, budget, report, threads), {}};
+    }
+}
+
+#endif